@@ -0,0 +1,673 @@
+/*
+ * Copyright (c) 2014, Juniper Networks, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*-
+ * actcache.c --
+ *	A cache of the outputs of targets, by their inputs.
+ *
+ *	When MAKE_ACTION_CACHE is set, the files a target's commands
+ *	wrote are kept in a directory, under a key made of the expanded
+ *	commands, the names and contents of the target's sources and the
+ *	environment variables chosen. A target with the same key later,
+ *	here or in another directory, gets its files back instead of
+ *	running the commands again.
+ *
+ *	The key cannot cover what the commands read besides the sources,
+ *	headers say, nor tell what else they wrote, so only the filemon
+ *	section of a .meta file can: the names and digests of the files
+ *	read are kept with the outputs, as ccache keeps a manifest, and
+ *	the outputs are only restored while those files are unchanged.
+ *	Without such a section, as without filemon(4), nothing is kept.
+ *	The .meta file is kept and restored with the outputs, so that
+ *	meta mode finds the target up-to-date afterwards.
+ *
+ *	The directory holds:
+ *
+ *	actions/xx/<key>	what the commands read and wrote
+ *	objects/xx/<digest>	the files they wrote, by their contents
+ *
+ *	Both are replaced by rename(2), so makes may share them without
+ *	locking. A file used is touched, and at exit the least recently
+ *	used are removed to keep the whole within MAKE_ACTION_CACHE_SIZE.
+ *
+ * Interface:
+ *	ActCache_Init		Find the directory.
+ *
+ *	ActCache_Restore	Restore the outputs of a target if its
+ *				inputs are known, else note its key.
+ *
+ *	ActCache_Store		Keep the outputs of a target just made.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "make.h"
+#ifdef USE_META
+#include "meta.h"
+#endif
+
+#define AC_ENV		"MAKE_ACTION_CACHE"
+#define AC_ENV_SIZE	"MAKE_ACTION_CACHE_SIZE"
+#define AC_ENV_VARS	"MAKE_ACTION_CACHE_ENV"
+#define AC_DIR		".make.actions"
+#define AC_SIZE		(1ULL << 30)	/* when no size is given */
+#define AC_VARS		"PATH"		/* when no variables are given */
+#define AC_MAGIC	"make-action 1\n"
+#define AC_END		"end\n"
+
+static char *ac_dir = NULL;		/* the cache, NULL if none */
+static unsigned long long ac_limit;	/* its size, in bytes */
+static Hash_Table ac_pending;		/* target name -> key, until made */
+static Boolean ac_stored = FALSE;	/* so something may go */
+static pid_t ac_pid;
+static char ac_cwd[MAXPATHLEN];
+
+/* The inputs and outputs of a target, for ActCache_Store */
+struct ac_files {
+	Hash_Table reads;
+	Hash_Table writes;
+	Boolean	outside;		/* wrote a file outside .OBJDIR */
+};
+
+/*
+ * The name of an entry: <dir>/<kind>/<first two of name>/<name>.
+ * Return FALSE if it does not fit in buf.
+ */
+static Boolean
+ac_path(char *buf, size_t bufsz, const char *kind, const char *name,
+    Boolean create)
+{
+	if ((size_t)snprintf(buf, bufsz, "%s/%s/%.2s/%s", ac_dir, kind,
+	    name, name) >= bufsz)
+		return FALSE;
+	if (create) {
+		snprintf(buf, bufsz, "%s/%s/%.2s", ac_dir, kind, name);
+		if (mkdir(buf, 0777) == -1 && errno == ENOENT) {
+			snprintf(buf, bufsz, "%s/%s", ac_dir, kind);
+			(void)mkdir(ac_dir, 0777);
+			(void)mkdir(buf, 0777);
+			snprintf(buf, bufsz, "%s/%s/%.2s", ac_dir, kind, name);
+			(void)mkdir(buf, 0777);
+		}
+		snprintf(buf, bufsz, "%s/%s/%.2s/%s", ac_dir, kind, name,
+		    name);
+	}
+	return TRUE;
+}
+
+/*
+ * Whether the outputs of gn can be known and kept at all.
+ */
+static Boolean
+ac_cacheable(GNode *gn)
+{
+	LstNode ln;
+	const char *cmd;
+
+#ifdef USE_META
+	/* only a .meta file can tell what the commands read and wrote */
+	if (!useMeta || (gn->type & OP_NOMETA))
+		return FALSE;
+#else
+	return FALSE;
+#endif
+	if (NoExecute(gn) || touchFlag || queryFlag ||
+	    Lst_IsEmpty(gn->commands) ||
+	    (gn->type & (OP_PHONY|OP_EXEC|OP_MAKE|OP_SPECIAL|OP_JOIN|
+		OP_USE|OP_USEBEFORE|OP_DOUBLEDEP|OP_SAVE_CMDS|
+		OP_ARCHV|OP_LIB|OP_MEMBER)))
+		return FALSE;
+	for (ln = Lst_First(gn->commands); ln != NULL; ln = Lst_Succ(ln)) {
+		cmd = (const char *)Lst_Datum(ln);
+		/*
+		 * Sub-makes write what they please, "..." defers to .END,
+		 * and some modifiers do things when expanded.
+		 */
+		if (strstr(cmd, "MAKE}") != NULL ||
+		    strstr(cmd, "MAKE)") != NULL ||
+		    strcmp(cmd, "...") == 0 ||
+		    strstr(cmd, ":!") != NULL || strstr(cmd, "::") != NULL ||
+		    strstr(cmd, ":sh") != NULL || strstr(cmd, ":_") != NULL)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * The key of gn, in hex: two digests of its commands, sources and
+ * chosen environment.
+ */
+static Boolean
+ac_key(GNode *gn, char *key, size_t keysz)
+{
+	Buffer buf;
+	LstNode ln;
+	GNode *cgn;
+	struct stat st;
+	const char *name, *val;
+	char *cp, *vars, *v, *last;
+	uint64_t d;
+	Boolean ok = TRUE;
+
+	Buf_Init(&buf, 0);
+	Buf_AddBytes(&buf, sizeof(AC_MAGIC), (const Byte *)AC_MAGIC);
+	name = gn->path ? gn->path : gn->name;
+	Buf_AddBytes(&buf, strlen(name) + 1, (const Byte *)name);
+	for (ln = Lst_First(gn->commands); ln != NULL; ln = Lst_Succ(ln)) {
+		cp = Var_Subst(NULL, (char *)Lst_Datum(ln), gn, FALSE);
+		Buf_AddBytes(&buf, strlen(cp) + 1, (const Byte *)cp);
+		free(cp);
+	}
+	Buf_AddByte(&buf, '\0');
+
+	for (ln = Lst_First(gn->children); ln != NULL; ln = Lst_Succ(ln)) {
+		cgn = (GNode *)Lst_Datum(ln);
+		if (cgn->type & (OP_USE|OP_USEBEFORE|OP_WAIT))
+			continue;
+		name = cgn->path ? cgn->path : cgn->name;
+		if ((cgn->type & (OP_PHONY|OP_EXEC|OP_FORCE|OP_JOIN|OP_ARCHV)) ||
+		    stat(name, &st) == -1) {
+			ok = FALSE;
+			break;
+		}
+		Buf_AddBytes(&buf, strlen(name) + 1, (const Byte *)name);
+		if (S_ISDIR(st.st_mode)) {
+			/* there to be written into, as a rule */
+			Buf_AddByte(&buf, 'd');
+			continue;
+		}
+		if (!S_ISREG(st.st_mode) || !Digest_File(name, &st, &d)) {
+			ok = FALSE;
+			break;
+		}
+		Buf_AddBytes(&buf, sizeof(d), (Byte *)&d);
+	}
+	Buf_AddByte(&buf, '\0');
+
+	if ((val = getenv(AC_ENV_VARS)) == NULL)
+		val = AC_VARS;
+	vars = bmake_strdup(val);
+	for (v = strtok_r(vars, " \t", &last); v != NULL;
+	    v = strtok_r(NULL, " \t", &last)) {
+		Buf_AddBytes(&buf, strlen(v) + 1, (const Byte *)v);
+		if ((val = getenv(v)) != NULL)
+			Buf_AddBytes(&buf, strlen(val) + 1, (const Byte *)val);
+	}
+	free(vars);
+
+	if (ok) {
+		cp = (char *)Buf_GetAll(&buf, NULL);
+		snprintf(key, keysz, "%016" PRIx64 "%016" PRIx64,
+		    Digest_Data(cp, Buf_Size(&buf), 0),
+		    Digest_Data(cp, Buf_Size(&buf), 1));
+	}
+	Buf_Destroy(&buf, TRUE);
+	return ok;
+}
+
+/*
+ * Copy the file from to the file to, through a temporary file, so that
+ * nobody sees half of it. Give to mode, if not -1, and return in sump
+ * the digest of the contents, if not NULL.
+ */
+static Boolean
+ac_copy(const char *from, const char *to, int mode, char *sump, size_t sumsz)
+{
+	char tmp[MAXPATHLEN], blob[MAXPATHLEN];
+	struct stat st;
+	char *data = NULL;
+	ssize_t n;
+	size_t off;
+	int ifd, ofd = -1;
+	Boolean mapped = FALSE, ok = FALSE;
+
+	if ((ifd = open(from, O_RDONLY)) == -1)
+		return FALSE;
+	if (fstat(ifd, &st) == -1 || !S_ISREG(st.st_mode))
+		goto out;
+#ifdef HAVE_MMAP
+	if (st.st_size > 0) {
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, ifd, 0);
+		if (data == MAP_FAILED)
+			data = NULL;
+		else
+			mapped = TRUE;
+	}
+#endif
+	if (data == NULL) {
+		data = bmake_malloc(st.st_size + 1);
+		for (off = 0; off < (size_t)st.st_size; off += n) {
+			n = read(ifd, data + off, st.st_size - off);
+			if (n == -1 && errno == EINTR)
+				n = 0;
+			else if (n <= 0)
+				goto out;
+		}
+	}
+	if (sump != NULL) {
+		snprintf(sump, sumsz, "%016" PRIx64 "%016" PRIx64,
+		    Digest_Data(data, st.st_size, 0),
+		    Digest_Data(data, st.st_size, 1));
+		if (!ac_path(blob, sizeof(blob), "objects", sump, TRUE))
+			goto out;
+		if (access(blob, F_OK) == 0) {
+			(void)utimes(blob, NULL);
+			ok = TRUE;
+			goto out;
+		}
+		to = blob;
+	}
+
+	if ((size_t)snprintf(tmp, sizeof(tmp), "%s.%ld", to,
+	    (long)getpid()) >= sizeof(tmp) ||
+	    (ofd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC, 0666)) == -1)
+		goto out;
+	for (off = 0; off < (size_t)st.st_size; off += n) {
+		n = write(ofd, data + off, st.st_size - off);
+		if (n == -1 && errno == EINTR)
+			n = 0;
+		else if (n <= 0)
+			break;
+	}
+	if (off == (size_t)st.st_size && (mode == -1 || fchmod(ofd, mode) == 0) &&
+	    close(ofd) == 0 && rename(tmp, to) == 0)
+		ok = TRUE;
+	else
+		(void)unlink(tmp);
+	ofd = -1;
+out:
+	if (ofd != -1)
+		(void)close(ofd);
+	if (mapped)
+		(void)munmap(data, st.st_size);
+	else
+		free(data);
+	(void)close(ifd);
+	return ok;
+}
+
+/*
+ * Check what the action in path read, then write what it wrote.
+ */
+static Boolean
+ac_replay(const char *path)
+{
+	char blob[MAXPATHLEN], sum[40];
+	char *data, *cp, *nl, *end;
+	struct stat st;
+	unsigned long long size;
+	unsigned int mode;
+	uint64_t d, want;
+	ssize_t n;
+	size_t len = 0;
+	int fd, off, pass;
+	Boolean ok = TRUE;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return FALSE;
+	if (fstat(fd, &st) == -1) {
+		(void)close(fd);
+		return FALSE;
+	}
+	data = bmake_malloc(st.st_size + 1);
+	while (len < (size_t)st.st_size &&
+	    ((n = read(fd, data + len, st.st_size - len)) > 0 ||
+		(n == -1 && errno == EINTR))) {
+		if (n > 0)
+			len += n;
+	}
+	(void)close(fd);
+	data[len] = '\0';
+	end = data + len;
+	if (len < sizeof(AC_MAGIC AC_END) - 1 ||
+	    memcmp(data, AC_MAGIC, sizeof(AC_MAGIC) - 1) != 0 ||
+	    memcmp(end - (sizeof(AC_END) - 1), AC_END,
+		sizeof(AC_END) - 1) != 0) {
+		free(data);
+		return FALSE;
+	}
+	end -= sizeof(AC_END) - 1;
+	*end = '\0';
+
+	/* first the inputs, so that nothing is written in vain */
+	for (pass = 0; ok && pass < 2; pass++) {
+		for (cp = data + sizeof(AC_MAGIC) - 1;
+		    ok && cp < end && (nl = strchr(cp, '\n')) != NULL;
+		    cp = nl + 1) {
+			*nl = '\0';
+			off = 0;
+			if (pass == 0 && *cp == 'I') {
+				if (sscanf(cp, "I %" SCNx64 " %n",
+				    &want, &off) < 1 || off == 0 ||
+				    stat(cp + off, &st) == -1 ||
+				    !S_ISREG(st.st_mode) ||
+				    !Digest_File(cp + off, &st, &d) ||
+				    d != want)
+					ok = FALSE;
+			} else if (pass == 1 && *cp == 'O') {
+				if (sscanf(cp, "O %o %llu %32s %n", &mode,
+				    &size, sum, &off) < 3 || off == 0) {
+					ok = FALSE;
+					break;
+				}
+				if (!ac_path(blob, sizeof(blob), "objects",
+				    sum, FALSE) ||
+				    !ac_copy(blob, cp + off, mode, NULL, 0))
+					ok = FALSE;
+				else
+					(void)utimes(blob, NULL);
+			}
+			*nl = '\n';
+		}
+	}
+	free(data);
+	if (ok)
+		(void)utimes(path, NULL);
+	return ok;
+}
+
+Boolean
+ActCache_Restore(GNode *gn)
+{
+	char key[40], path[MAXPATHLEN];
+	Hash_Entry *he;
+	Boolean new;
+
+	if (ac_dir == NULL || !ac_cacheable(gn) ||
+	    !ac_key(gn, key, sizeof(key)) ||
+	    !ac_path(path, sizeof(path), "actions", key, FALSE))
+		return FALSE;
+	if (ac_replay(path)) {
+		PROF_COUNT(PROF_ACTION_HITS);
+		if (DEBUG(MAKE) || DEBUG(JOB))
+			fprintf(debug_file, "%s: restored from %s\n",
+			    gn->name, path);
+		return TRUE;
+	}
+	PROF_COUNT(PROF_ACTION_MISSES);
+	he = Hash_CreateEntry(&ac_pending, gn->name, &new);
+	if (!new)
+		free(Hash_GetValue(he));
+	Hash_SetValue(he, bmake_strdup(key));
+	return FALSE;
+}
+
+#ifdef USE_META
+/*
+ * Note a file the .meta file of the target names.
+ */
+static void
+ac_note(int type, const char *name, void *arg)
+{
+	struct ac_files *af = arg;
+	size_t n = strlen(ac_cwd);
+	struct stat st;
+
+	if (type == 'R') {
+		(void)Hash_CreateEntry(&af->reads, name, NULL);
+		return;
+	}
+	if (stat(name, &st) == -1 || !S_ISREG(st.st_mode))
+		return;			/* gone since, or /dev/null */
+	if (strncmp(name, ac_cwd, n) == 0 && name[n] == '/')
+		(void)Hash_CreateEntry(&af->writes, name + n + 1, NULL);
+	else
+		af->outside = TRUE;
+}
+#endif
+
+void
+ActCache_Store(GNode *gn)
+{
+	struct ac_files af;
+	Hash_Search search;
+	Hash_Entry *he;
+	struct stat st;
+	Buffer buf;
+	FILE *fp;
+	char key[40], sum[40], line[MAXPATHLEN + 128];
+	char path[MAXPATHLEN], tmp[MAXPATHLEN];
+	const char *name;
+	uint64_t d;
+	size_t n;
+	Boolean ok = TRUE;
+
+	if (ac_dir == NULL ||
+	    (he = Hash_FindEntry(&ac_pending, gn->name)) == NULL)
+		return;
+	snprintf(key, sizeof(key), "%s", (char *)Hash_GetValue(he));
+	free(Hash_GetValue(he));
+	Hash_DeleteEntry(&ac_pending, he);
+
+	name = gn->path ? gn->path : gn->name;
+	if (stat(name, &st) == -1 || !S_ISREG(st.st_mode))
+		return;			/* not a file, so not worth it */
+
+	Hash_InitTable(&af.reads, 0);
+	Hash_InitTable(&af.writes, 0);
+	af.outside = FALSE;
+	n = strlen(ac_cwd);
+	if (*name == '/' && strncmp(name, ac_cwd, n) == 0 && name[n] == '/')
+		name += n + 1;
+	(void)Hash_CreateEntry(&af.writes, name, NULL);
+#ifdef USE_META
+	/* what it read and wrote besides, the .meta file with them */
+	if (!meta_files(gn, ac_note, &af))
+		ok = FALSE;
+#else
+	ok = FALSE;
+#endif
+	if (af.outside)
+		ok = FALSE;
+
+	Buf_Init(&buf, 0);
+	Buf_AddBytes(&buf, sizeof(AC_MAGIC) - 1, (const Byte *)AC_MAGIC);
+	for (he = Hash_EnumFirst(&af.reads, &search); ok && he != NULL;
+	    he = Hash_EnumNext(&search)) {
+		/* what it wrote it may well have read back */
+		if (strncmp(he->name, ac_cwd, n) == 0 && he->name[n] == '/' &&
+		    Hash_FindEntry(&af.writes, he->name + n + 1) != NULL)
+			continue;
+		if (strchr(he->name, '\n') != NULL)
+			ok = FALSE;
+		else if (stat(he->name, &st) == 0 && S_ISREG(st.st_mode)) {
+			if (!Digest_File(he->name, &st, &d))
+				ok = FALSE;
+			else {
+				if ((size_t)snprintf(line, sizeof(line),
+				    "I %016" PRIx64 " %s\n", d, he->name) >=
+				    sizeof(line))
+					ok = FALSE;
+				else
+					Buf_AddBytes(&buf, strlen(line),
+					    (const Byte *)line);
+			}
+		}
+	}
+	for (he = Hash_EnumFirst(&af.writes, &search); ok && he != NULL;
+	    he = Hash_EnumNext(&search)) {
+		if (strchr(he->name, '\n') != NULL ||
+		    stat(he->name, &st) == -1 ||
+		    !ac_copy(he->name, NULL, -1, sum, sizeof(sum)))
+			ok = FALSE;
+		else if ((size_t)snprintf(line, sizeof(line),
+		    "O %o %llu %s %s\n", (unsigned int)(st.st_mode & 07777),
+		    (unsigned long long)st.st_size, sum, he->name) >=
+		    sizeof(line))
+			ok = FALSE;
+		else
+			Buf_AddBytes(&buf, strlen(line), (const Byte *)line);
+	}
+	Buf_AddBytes(&buf, sizeof(AC_END) - 1, (const Byte *)AC_END);
+
+	if (ok && ac_path(path, sizeof(path), "actions", key, TRUE) &&
+	    (size_t)snprintf(tmp, sizeof(tmp), "%s.%ld", path,
+		(long)getpid()) < sizeof(tmp)) {
+		if ((fp = fopen(tmp, "w")) != NULL) {
+			fwrite(Buf_GetAll(&buf, NULL), 1, Buf_Size(&buf), fp);
+			if (fclose(fp) == 0 && rename(tmp, path) == 0)
+				ac_stored = TRUE;
+			else
+				(void)unlink(tmp);
+		}
+		if (DEBUG(MAKE) || DEBUG(JOB))
+			fprintf(debug_file, "%s: kept in %s\n", gn->name, path);
+	}
+	Buf_Destroy(&buf, TRUE);
+	Hash_DeleteTable(&af.reads);
+	Hash_DeleteTable(&af.writes);
+}
+
+struct ac_entry {
+	char	*name;
+	time_t	mtime;
+	off_t	size;
+	int	blob;			/* under objects/ */
+};
+
+static int
+ac_older(const void *a, const void *b)
+{
+	const struct ac_entry *ea = a, *eb = b;
+
+	/* within a second, the bytes go first and the actions stay */
+	if (ea->mtime != eb->mtime)
+		return ea->mtime < eb->mtime ? -1 : 1;
+	return eb->blob - ea->blob;
+}
+
+/*
+ * Remove the least recently used entries until the cache is back
+ * within nine tenths of its size.
+ */
+static void
+ac_end(void)
+{
+	static const char *kinds[] = { "actions", "objects" };
+	struct ac_entry *ents = NULL;
+	struct dirent *dp, *sdp;
+	struct stat st;
+	DIR *d, *sd;
+	char path[MAXPATHLEN], sub[MAXPATHLEN], file[MAXPATHLEN];
+	unsigned long long total = 0;
+	size_t i, k, nents = 0, maxents = 0;
+
+	if (!ac_stored || getpid() != ac_pid)
+		return;
+	for (k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+		if ((size_t)snprintf(path, sizeof(path), "%s/%s", ac_dir,
+		    kinds[k]) >= sizeof(path) || (d = opendir(path)) == NULL)
+			continue;
+		while ((dp = readdir(d)) != NULL) {
+			if (dp->d_name[0] == '.')
+				continue;
+			if ((size_t)snprintf(sub, sizeof(sub), "%s/%s", path,
+			    dp->d_name) >= sizeof(sub) ||
+			    (sd = opendir(sub)) == NULL)
+				continue;
+			while ((sdp = readdir(sd)) != NULL) {
+				if (sdp->d_name[0] == '.')
+					continue;
+				if (nents == maxents) {
+					maxents = maxents ? 2 * maxents : 256;
+					ents = bmake_realloc(ents,
+					    maxents * sizeof(*ents));
+				}
+				if ((size_t)snprintf(file, sizeof(file),
+				    "%s/%s", sub, sdp->d_name) >= sizeof(file) ||
+				    stat(file, &st) == -1)
+					continue;
+				ents[nents].name = bmake_strdup(file);
+				ents[nents].mtime = st.st_mtime;
+				ents[nents].size = st.st_size;
+				ents[nents].blob = k == 1;
+				total += st.st_size;
+				nents++;
+			}
+			closedir(sd);
+		}
+		closedir(d);
+	}
+	if (total > ac_limit) {
+		qsort(ents, nents, sizeof(*ents), ac_older);
+		for (i = 0; i < nents && total > ac_limit - ac_limit / 10; i++)
+			if (unlink(ents[i].name) == 0)
+				total -= ents[i].size;
+	}
+	for (i = 0; i < nents; i++)
+		free(ents[i].name);
+	free(ents);
+}
+
+void
+ActCache_Init(const char *objdir)
+{
+	const char *env;
+	char path[MAXPATHLEN], *cp;
+
+	if ((env = getenv(AC_ENV)) == NULL || *env == '\0')
+		return;
+	if ((size_t)snprintf(path, sizeof(path), "%s%s%s",
+	    *env == '/' ? env : objdir, *env == '/' ? "" : "/",
+	    *env == '/' ? "" : AC_DIR) >= sizeof(path) ||
+	    getcwd(ac_cwd, sizeof(ac_cwd)) == NULL)
+		return;
+	ac_dir = bmake_strdup(path);
+	ac_limit = AC_SIZE;
+	if ((env = getenv(AC_ENV_SIZE)) != NULL) {
+		ac_limit = strtoull(env, &cp, 0);
+		switch (*cp) {
+		case 'g': case 'G':
+			ac_limit <<= 10;
+			/* FALLTHROUGH */
+		case 'm': case 'M':
+			ac_limit <<= 10;
+			/* FALLTHROUGH */
+		case 'k': case 'K':
+			ac_limit <<= 10;
+			break;
+		}
+	}
+	Hash_InitTable(&ac_pending, 0);
+	ac_pid = getpid();
+	atexit(ac_end);
+	if (DEBUG(MAKE))
+		fprintf(debug_file, "Action cache in %s\n", ac_dir);
+}
@@ -88,7 +88,7 @@ __RCSID("$NetBSD: arch.c,v 1.63 2012/06/12 19:21:50 joerg Exp $");
  *	Once again, cacheing/hashing comes into play in the manipulation
  * of archives. The first time an archive is referenced, all of its members'
  * headers are read and hashed and the archive closed again. All hashed
- * archives are kept on a list which is searched each time an archive member
+ * archives are kept in a table which is consulted each time an archive member
  * is referenced.
  *
  * The interface to this module is:
@@ -162,10 +162,19 @@ struct ar_hdr {
 #ifdef HAVE_UTIME_H
 #include    <utime.h>
 #endif
+#ifdef HAVE_MMAP
+#include    <sys/mman.h>
+#ifndef MAP_FILE
+#define MAP_FILE 0
+#endif
+#endif
 
 #include    "make.h"
 #include    "hash.h"
 #include    "dir.h"
+#ifdef ECB2G
+#include    "ecb2g.h"
+#endif
 
 #ifdef TARGET_MACHINE
 #undef MAKE_MACHINE
@@ -176,25 +185,33 @@ struct ar_hdr {
 #define MAKE_MACHINE_ARCH TARGET_MACHINE_ARCH
 #endif
 
-static Lst	  archives;   /* Lst of archives we've already examined */
+static Hash_Table archives;   /* Archives we've already examined, keyed
+				* by path */
 
 typedef struct Arch {
     char	  *name;      /* Name of archive */
     Hash_Table	  members;    /* All the members of the archive described
-			       * by <name, struct ar_hdr *> key/value pairs */
+			       * by <name, ArchMember *> key/value pairs */
     char	  *fnametab;  /* Extended name table strings */
     size_t	  fnamesize;  /* Size of the string table */
 } Arch;
 
-static int ArchFindArchive(const void *, const void *);
+typedef struct ArchMember {
+    struct ar_hdr arh;	      /* Header as read; must be first */
+    long	  offset;     /* Offset of the header in the archive */
+} ArchMember;
+
 #ifdef CLEANUP
 static void ArchFree(void *);
 #endif
+static char *ArchLoad(const char *, size_t *, size_t *);
+static void ArchUnload(char *, size_t);
 static struct ar_hdr *ArchStatMember(char *, char *, Boolean);
+static ArchMember *ArchLookupMember(const char *, const char *);
 static FILE *ArchFindMember(char *, char *, struct ar_hdr *, const char *);
 #if defined(__svr4__) || defined(__SVR4) || defined(__ELF__)
 #define SVR4ARCHIVES
-static int ArchSVR4Entry(Arch *, char *, size_t, FILE *);
+static int ArchSVR4Entry(Arch *, char *, size_t, const char *, size_t);
 #endif
 
 
@@ -224,7 +241,7 @@ static int ArchSVR4Entry(Arch *, char *, size_t, FILE *);
 # define SARMAG	8
 #endif
 
-#define AR_MAX_NAME_LEN	    (sizeof(arh.AR_NAME)-1)
+#define AR_MAX_NAME_LEN	    (sizeof(((struct ar_hdr *)0)->AR_NAME)-1)
 
 #ifdef CLEANUP
 /*-
@@ -525,26 +542,146 @@ Arch_ParseArchive(char **linePtr, Lst nodeLst, GNode *ctxt)
 
 /*-
  *-----------------------------------------------------------------------
- * ArchFindArchive --
- *	See if the given archive is the one we are looking for. Called
- *	From ArchStatMember and ArchFindMember via Lst_Find.
+ * ArchLoad --
+ *	Bring the whole of an archive into memory so its headers can be
+ *	walked without a seek and a read per member.
  *
  * Input:
- *	ar		Current list element
- *	archName	Name we want
+ *	archive		Path to the archive
+ *	lenp		Filled in with the number of bytes available
+ *	maplenp		Filled in with the length of the mapping, or 0
+ *			if the archive was read into malloc'd memory
  *
  * Results:
- *	0 if it is, non-zero if it isn't.
+ *	The contents of the archive, or NULL if it could not be opened.
  *
  * Side Effects:
+ *	The result must be released with ArchUnload.
+ *
+ *-----------------------------------------------------------------------
+ */
+static char *
+ArchLoad(const char *archive, size_t *lenp, size_t *maplenp)
+{
+    struct stat	  st;
+    char	  *buf;
+    size_t	  len, bufsize;
+    ssize_t	  n;
+    int		  fd;
+
+    fd = open(archive, O_RDONLY);
+#ifdef ECB2G
+    /* member times decide what is out of date, so they are inputs */
+    if (fd < 0)
+	ecb2gSnapshotFile(archive, NULL);
+    else
+	ecb2gSnapshotFd(archive, fd);
+#endif
+    if (fd < 0)
+	return NULL;
+
+    *maplenp = 0;
+    st.st_size = 0;
+#ifdef HAVE_MMAP
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+	(off_t)(size_t)st.st_size == st.st_size) {
+	buf = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_FILE|MAP_PRIVATE,
+		   fd, 0);
+	if (buf != MAP_FAILED) {
+	    (void)close(fd);
+	    *lenp = *maplenp = (size_t)st.st_size;
+	    return buf;
+	}
+    }
+#else
+    (void)fstat(fd, &st);
+#endif
+    /* cannot mmap; load the traditional way */
+    bufsize = st.st_size > 0 ? (size_t)st.st_size : 1024;
+    buf = bmake_malloc(bufsize);
+    len = 0;
+    for (;;) {
+	if (len == bufsize) {
+	    bufsize *= 2;
+	    buf = bmake_realloc(buf, bufsize);
+	}
+	n = read(fd, buf + len, bufsize - len);
+	if (n <= 0)
+	    break;
+	len += n;
+    }
+    (void)close(fd);
+    if (n < 0) {
+	free(buf);
+	return NULL;
+    }
+    *lenp = len;
+    return buf;
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * ArchUnload --
+ *	Release the memory obtained from ArchLoad.
+ *
+ * Results:
  *	None.
  *
+ * Side Effects:
+ *	The archive contents are unmapped or freed.
+ *
  *-----------------------------------------------------------------------
  */
-static int
-ArchFindArchive(const void *ar, const void *archName)
+static void
+ArchUnload(char *buf, size_t maplen)
+{
+#ifdef HAVE_MMAP
+    if (maplen != 0) {
+	munmap(buf, maplen);
+	return;
+    }
+#endif
+    free(buf);
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * ArchLookupMember --
+ *	Find a member in an archive that has already been hashed.
+ *
+ * Input:
+ *	archive		Path to the archive
+ *	member		Final path component of the member
+ *
+ * Results:
+ *	The member's descriptor, or NULL if the archive has not been
+ *	hashed or holds no such member.
+ *
+ * Side Effects:
+ *	None.
+ *
+ *-----------------------------------------------------------------------
+ */
+static ArchMember *
+ArchLookupMember(const char *archive, const char *member)
 {
-    return (strcmp(archName, ((const Arch *)ar)->name));
+    Hash_Entry	  *he;
+    Arch	  *ar;
+    char	  copy[AR_MAX_NAME_LEN+1];
+
+    he = Hash_FindEntry(&archives, archive);
+    if (he == NULL)
+	return NULL;
+    ar = (Arch *)Hash_GetValue(he);
+
+    he = Hash_FindEntry(&ar->members, member);
+    if (he == NULL && strlen(member) > AR_MAX_NAME_LEN) {
+	/* Try truncated name */
+	strncpy(copy, member, AR_MAX_NAME_LEN);
+	copy[AR_MAX_NAME_LEN] = '\0';
+	he = Hash_FindEntry(&ar->members, copy);
+    }
+    return he != NULL ? (ArchMember *)Hash_GetValue(he) : NULL;
 }
 
 /*-
@@ -567,19 +704,27 @@ ArchFindArchive(const void *ar, const void *archName)
  *	there's not much point in remembering the position...
  *
  * Side Effects:
+ *	The first time an archive is hashed it is loaded whole (see
+ *	ArchLoad) and every header is recorded, along with its offset
+ *	so ArchFindMember can go straight to it later.
  *
  *-----------------------------------------------------------------------
  */
 static struct ar_hdr *
 ArchStatMember(char *archive, char *member, Boolean hash)
 {
-    FILE *	  arch;	      /* Stream to archive */
-    int		  size;       /* Size of archive member */
+    char	  *buf;	      /* Contents of archive */
+    size_t	  len;	      /* Bytes in buf */
+    size_t	  maplen;     /* Length of mapping of buf, or 0 */
+    size_t	  pos;	      /* Offset of current header in buf */
+    size_t	  avail;      /* Bytes following current header */
+    size_t	  next;       /* Offset of the following header */
+    long	  size;       /* Size of archive member */
     char	  *cp;	      /* Useful character pointer */
-    char	  magic[SARMAG];
-    LstNode	  ln;	      /* Lst member containing archive descriptor */
     Arch	  *ar;	      /* Archive descriptor */
+    ArchMember	  *am;	      /* Description of a member */
     Hash_Entry	  *he;	      /* Entry containing member's description */
+    Hash_Search	  search;
     struct ar_hdr arh;        /* archive-member header for reading archive */
     char	  memName[MAXPATHLEN+1];
     	    	    	    /* Current member name while hashing. */
@@ -595,28 +740,9 @@ ArchStatMember(char *archive, char *member, Boolean hash)
 	member = cp + 1;
     }
 
-    ln = Lst_Find(archives, archive, ArchFindArchive);
-    if (ln != NULL) {
-	ar = (Arch *)Lst_Datum(ln);
-
-	he = Hash_FindEntry(&ar->members, member);
-
-	if (he != NULL) {
-	    return ((struct ar_hdr *)Hash_GetValue(he));
-	} else {
-	    /* Try truncated name */
-	    char copy[AR_MAX_NAME_LEN+1];
-	    size_t len = strlen(member);
-
-	    if (len > AR_MAX_NAME_LEN) {
-		len = AR_MAX_NAME_LEN;
-		strncpy(copy, member, AR_MAX_NAME_LEN);
-		copy[AR_MAX_NAME_LEN] = '\0';
-	    }
-	    if ((he = Hash_FindEntry(&ar->members, copy)) != NULL)
-		return ((struct ar_hdr *)Hash_GetValue(he));
-	    return NULL;
-	}
+    if (Hash_FindEntry(&archives, archive) != NULL) {
+	am = ArchLookupMember(archive, member);
+	return am != NULL ? &am->arh : NULL;
     }
 
     if (!hash) {
@@ -628,6 +754,7 @@ ArchStatMember(char *archive, char *member, Boolean hash)
 	 * so just declare it static.
 	 */
 	 static struct ar_hdr	sarh;
+	 FILE *arch;
 
 	 arch = ArchFindMember(archive, member, &sarh, "r");
 
@@ -643,8 +770,8 @@ ArchStatMember(char *archive, char *member, Boolean hash)
      * We don't have this archive on the list yet, so we want to find out
      * everything that's in it and cache it so we can get at it quickly.
      */
-    arch = fopen(archive, "r");
-    if (arch == NULL) {
+    buf = ArchLoad(archive, &len, &maplen);
+    if (buf == NULL) {
 	return NULL;
     }
 
@@ -652,10 +779,9 @@ ArchStatMember(char *archive, char *member, Boolean hash)
      * We use the ARMAG string to make sure this is an archive we
      * can handle...
      */
-    if ((fread(magic, SARMAG, 1, arch) != 1) ||
-    	(strncmp(magic, ARMAG, SARMAG) != 0)) {
-	    fclose(arch);
-	    return NULL;
+    if (len < SARMAG || strncmp(buf, ARMAG, SARMAG) != 0) {
+	ArchUnload(buf, maplen);
+	return NULL;
     }
 
     ar = bmake_malloc(sizeof(Arch));
@@ -665,102 +791,116 @@ ArchStatMember(char *archive, char *member, Boolean hash)
     Hash_InitTable(&ar->members, -1);
     memName[AR_MAX_NAME_LEN] = '\0';
 
-    while (fread((char *)&arh, sizeof(struct ar_hdr), 1, arch) == 1) {
+    for (pos = SARMAG; len - pos >= sizeof(struct ar_hdr); pos = next) {
+	memcpy(&arh, buf + pos, sizeof(struct ar_hdr));
+	avail = len - pos - sizeof(struct ar_hdr);
 	if (strncmp( arh.AR_FMAG, ARFMAG, sizeof(arh.AR_FMAG)) != 0) {
 	    /*
 	     * The header is bogus, so the archive is bad
 	     * and there's no way we can recover...
 	     */
 	    goto badarch;
-	} else {
-	    /*
-	     * We need to advance the stream's pointer to the start of the
-	     * next header. Files are padded with newlines to an even-byte
-	     * boundary, so we need to extract the size of the file from the
-	     * 'size' field of the header and round it up during the seek.
-	     */
-	    arh.AR_SIZE[sizeof(arh.AR_SIZE)-1] = '\0';
-	    size = (int)strtol(arh.AR_SIZE, NULL, 10);
+	}
 
-	    (void)strncpy(memName, arh.AR_NAME, sizeof(arh.AR_NAME));
-	    for (cp = &memName[AR_MAX_NAME_LEN]; *cp == ' '; cp--) {
-		continue;
-	    }
-	    cp[1] = '\0';
+	/*
+	 * Files are padded with newlines to an even-byte boundary, so
+	 * the size of the file from the 'size' field of the header is
+	 * rounded up to find the next header.  A member running off the
+	 * end of the archive ends the walk.
+	 */
+	arh.AR_SIZE[sizeof(arh.AR_SIZE)-1] = '\0';
+	size = strtol(arh.AR_SIZE, NULL, 10);
+	if (size < 0)
+	    goto badarch;
+	if ((size_t)size >= avail)
+	    next = len;
+	else
+	    next = pos + sizeof(struct ar_hdr) + (size_t)((size + 1) & ~1);
+	if (next > len)
+	    next = len;
+
+	(void)strncpy(memName, arh.AR_NAME, sizeof(arh.AR_NAME));
+	for (cp = &memName[AR_MAX_NAME_LEN]; *cp == ' '; cp--) {
+	    continue;
+	}
+	cp[1] = '\0';
 
 #ifdef SVR4ARCHIVES
+	/*
+	 * svr4 names are slash terminated. Also svr4 extended AR format.
+	 */
+	if (memName[0] == '/') {
 	    /*
-	     * svr4 names are slash terminated. Also svr4 extended AR format.
+	     * svr4 magic mode; handle it
 	     */
-	    if (memName[0] == '/') {
-		/*
-		 * svr4 magic mode; handle it
-		 */
-		switch (ArchSVR4Entry(ar, memName, size, arch)) {
-		case -1:  /* Invalid data */
-		    goto badarch;
-		case 0:	  /* List of files entry */
-		    continue;
-		default:  /* Got the entry */
-		    break;
-		}
-	    }
-	    else {
-		if (cp[0] == '/')
-		    cp[0] = '\0';
+	    switch (ArchSVR4Entry(ar, memName, (size_t)size,
+				  buf + pos + sizeof(struct ar_hdr), avail)) {
+	    case -1:  /* Invalid data */
+		goto badarch;
+	    case 0:	  /* List of files entry */
+		continue;
+	    default:  /* Got the entry */
+		break;
 	    }
+	}
+	else {
+	    if (cp[0] == '/')
+		cp[0] = '\0';
+	}
 #endif
 
 #ifdef AR_EFMT1
-	    /*
-	     * BSD 4.4 extended AR format: #1/<namelen>, with name as the
-	     * first <namelen> bytes of the file
-	     */
-	    if (strncmp(memName, AR_EFMT1, sizeof(AR_EFMT1) - 1) == 0 &&
-		isdigit((unsigned char)memName[sizeof(AR_EFMT1) - 1])) {
+	/*
+	 * BSD 4.4 extended AR format: #1/<namelen>, with name as the
+	 * first <namelen> bytes of the file
+	 */
+	if (strncmp(memName, AR_EFMT1, sizeof(AR_EFMT1) - 1) == 0 &&
+	    isdigit((unsigned char)memName[sizeof(AR_EFMT1) - 1])) {
 
-		unsigned int elen = atoi(&memName[sizeof(AR_EFMT1)-1]);
+	    unsigned int elen = atoi(&memName[sizeof(AR_EFMT1)-1]);
 
-		if (elen > MAXPATHLEN)
-			goto badarch;
-		if (fread(memName, elen, 1, arch) != 1)
-			goto badarch;
-		memName[elen] = '\0';
-		fseek(arch, -elen, SEEK_CUR);
-		if (DEBUG(ARCH) || DEBUG(MAKE)) {
-		    fprintf(debug_file, "ArchStat: Extended format entry for %s\n", memName);
-		}
+	    if (elen > MAXPATHLEN || elen > avail)
+		    goto badarch;
+	    memcpy(memName, buf + pos + sizeof(struct ar_hdr), elen);
+	    memName[elen] = '\0';
+	    if (DEBUG(ARCH) || DEBUG(MAKE)) {
+		fprintf(debug_file, "ArchStat: Extended format entry for %s\n", memName);
 	    }
+	}
 #endif
 
-	    he = Hash_CreateEntry(&ar->members, memName, NULL);
-	    Hash_SetValue(he, bmake_malloc(sizeof(struct ar_hdr)));
-	    memcpy(Hash_GetValue(he), &arh, sizeof(struct ar_hdr));
+	he = Hash_CreateEntry(&ar->members, memName, NULL);
+	am = Hash_GetValue(he);
+	if (am == NULL) {
+	    am = bmake_malloc(sizeof(ArchMember));
+	    Hash_SetValue(he, am);
 	}
-	fseek(arch, (size + 1) & ~1, SEEK_CUR);
+	memcpy(&am->arh, &arh, sizeof(struct ar_hdr));
+	am->offset = (long)pos;
     }
 
-    fclose(arch);
+    ArchUnload(buf, maplen);
 
-    (void)Lst_AtEnd(archives, ar);
+    he = Hash_CreateEntry(&archives, ar->name, NULL);
+    Hash_SetValue(he, ar);
 
     /*
      * Now that the archive has been read and cached, we can look into
      * the hash table to find the desired member's header.
      */
-    he = Hash_FindEntry(&ar->members, member);
-
-    if (he != NULL) {
-	return ((struct ar_hdr *)Hash_GetValue(he));
-    } else {
-	return NULL;
-    }
+    am = ArchLookupMember(archive, member);
+    return am != NULL ? &am->arh : NULL;
 
 badarch:
-    fclose(arch);
+    ArchUnload(buf, maplen);
+    for (he = Hash_EnumFirst(&ar->members, &search);
+	 he != NULL;
+	 he = Hash_EnumNext(&search))
+	free(Hash_GetValue(he));
     Hash_DeleteTable(&ar->members);
     if (ar->fnametab)
 	free(ar->fnametab);
+    free(ar->name);
     free(ar);
     return NULL;
 }
@@ -774,6 +914,13 @@ badarch:
  *	If it is "/<offset>", then try to substitute the long file name
  *	from offset of a table previously read.
  *
+ * Input:
+ *	ar		Archive being hashed
+ *	name		Member name from the header; may be replaced
+ *	size		Size of the member
+ *	data		Start of the member's contents
+ *	avail		Bytes available at data
+ *
  * Results:
  *	-1: Bad data in archive
  *	 0: A table was loaded from the file
@@ -781,13 +928,14 @@ badarch:
  *	 2: Name was not successfully substituted from table
  *
  * Side Effects:
- *	If a table is read, the file pointer is moved to the next archive
- *	member
+ *	If a table is read, it is copied to ar->fnametab and kept with
+ *	the archive.
  *
  *-----------------------------------------------------------------------
  */
 static int
-ArchSVR4Entry(Arch *ar, char *name, size_t size, FILE *arch)
+ArchSVR4Entry(Arch *ar, char *name, size_t size, const char *data,
+    size_t avail)
 {
 #define ARLONGNAMES1 "//"
 #define ARLONGNAMES2 "/ARFILENAMES"
@@ -808,15 +956,15 @@ ArchSVR4Entry(Arch *ar, char *name, size_t size, FILE *arch)
 	 * This is a table of archive names, so we build one for
 	 * ourselves
 	 */
-	ar->fnametab = bmake_malloc(size);
-	ar->fnamesize = size;
-
-	if (fread(ar->fnametab, size, 1, arch) != 1) {
+	if (size > avail) {
 	    if (DEBUG(ARCH)) {
 		fprintf(debug_file, "Reading an SVR4 name table failed\n");
 	    }
 	    return -1;
 	}
+	ar->fnametab = bmake_malloc(size);
+	ar->fnamesize = size;
+	memcpy(ar->fnametab, data, size);
 	eptr = ar->fnametab + size;
 	for (entry = 0, ptr = ar->fnametab; ptr < eptr; ptr++)
 	    switch (*ptr) {
@@ -900,12 +1048,40 @@ ArchFindMember(char *archive, char *member, struct ar_hdr *arhPtr,
     char	  *cp;	      /* Useful character pointer */
     char	  magic[SARMAG];
     size_t	  len, tlen;
+    ArchMember	  *am;
 
     arch = fopen(archive, mode);
+#ifdef ECB2G
+    if (*mode == 'r' && mode[1] == '\0') {
+	if (arch == NULL)
+	    ecb2gSnapshotFile(archive, NULL);
+	else
+	    ecb2gSnapshotFd(archive, fileno(arch));
+    }
+#endif
     if (arch == NULL) {
 	return NULL;
     }
 
+    /*
+     * If the archive has been hashed we know where the member's header
+     * was, long names included. Go straight there, and fall back to
+     * the scan below if the archive has changed under us.
+     */
+    cp = strrchr(member, '/');
+    am = ArchLookupMember(archive, cp != NULL ? cp + 1 : member);
+    if (am != NULL) {
+	if (fseek(arch, am->offset, SEEK_SET) == 0 &&
+	    fread((char *)arhPtr, sizeof(struct ar_hdr), 1, arch) == 1 &&
+	    strncmp(arhPtr->AR_FMAG, ARFMAG, sizeof(arhPtr->AR_FMAG)) == 0 &&
+	    memcmp(arhPtr->AR_NAME, am->arh.AR_NAME,
+		   sizeof(arhPtr->AR_NAME)) == 0) {
+	    fseek(arch, am->offset, SEEK_SET);
+	    return (arch);
+	}
+	rewind(arch);
+    }
+
     /*
      * We use the ARMAG string to make sure this is an archive we
      * can handle...
@@ -1336,14 +1512,14 @@ Arch_LibOODate(GNode *gn)
  *	None.
  *
  * Side Effects:
- *	The 'archives' list is initialized.
+ *	The 'archives' table is initialized.
  *
  *-----------------------------------------------------------------------
  */
 void
 Arch_Init(void)
 {
-    archives = Lst_Init(FALSE);
+    Hash_InitTable(&archives, 0);
 }
 
 
@@ -1357,7 +1533,7 @@ Arch_Init(void)
  *	None.
  *
  * Side Effects:
- *	The 'archives' list is freed
+ *	The 'archives' table is freed
  *
  *-----------------------------------------------------------------------
  */
@@ -1365,7 +1541,14 @@ void
 Arch_End(void)
 {
 #ifdef CLEANUP
-    Lst_Destroy(archives, ArchFree);
+    Hash_Search	  search;
+    Hash_Entry	  *he;
+
+    for (he = Hash_EnumFirst(&archives, &search);
+	 he != NULL;
+	 he = Hash_EnumNext(&search))
+	ArchFree(Hash_GetValue(he));
+    Hash_DeleteTable(&archives);
 #endif
 }
 
@@ -386,6 +386,8 @@ again:
     }
     if (cpid == 0) {
 	Var_ExportVars();
+	if (gn->type & OP_MAKE)
+	    Job_ServerPass();
 #ifdef USE_META
 	if (useMeta) {
 	    meta_compat_child();
@@ -554,7 +556,7 @@ Compat_Make(void *gnp, void *pgnp)
 	    fprintf(debug_file, "Examining %s...", gn->name);
 	}
 #ifdef ECB2G
-	if (ecb2gEnabled() && ! Make_OODate(gn)) {
+	if (ecb2gEnabled() && !ecb2gSkipOODate() && ! Make_OODate(gn)) {
 #else
 	if (! Make_OODate(gn)) {
 #endif
@@ -602,7 +604,9 @@ Compat_Make(void *gnp, void *pgnp)
 	    int (*ecb2gTargetCommandsCb)(void *cmdp, void *gnp);
 	    ecb2gTargetCommandsCb = ecb2gOut(CompatRunCommand, gn);
 #endif
-	    if (!touchFlag || (gn->type & OP_MAKE)) {
+	    if (ActCache_Restore(gn)) {
+		/* made before from the same commands and sources */
+	    } else if (!touchFlag || (gn->type & OP_MAKE)) {
 		curTarg = gn;
 #ifdef USE_META
 		if (useMeta && !NoExecute(gn)) {
@@ -638,10 +642,15 @@ Compat_Make(void *gnp, void *pgnp)
 	     * that for .ZEROTIME targets, the timestamping isn't done.
 	     * This is to keep its state from affecting that of its parent.
 	     */
+	    ActCache_Store(gn);
 #ifdef ECB2G
 	    int prev = gn->made;
 #endif
 	    gn->made = MADE;
+#ifdef ECB2G
+	    /* nobody looks at FORCE when datedness is not checked */
+	    if (TRANSLATED != prev || !ecb2gSkipOODate())
+#endif
 	    pgn->flags |= Make_Recheck(gn) == 0 ? FORCE : 0;
 #ifdef ECB2G
 	    /* If this was a translation, During rebuilds we have issues.
@@ -782,6 +791,7 @@ Compat_Run(Lst targs)
     errors = 0;
 
 #ifdef ECB2G
+    Prof_Phase("translate");
     ecb2gDefault(targs, dirSearchPath);
 #endif
 
@@ -89,6 +89,10 @@ __RCSID("$NetBSD: cond.c,v 1.67 2012/11/03 13:59:27 christos Exp $");
  * Interface:
  *	Cond_Eval 	Evaluate the conditional in the passed line.
  *
+ *	Cond_FlushExists
+ *			Forget the remembered results of exists(), after
+ *			the search path changed or files were made.
+ *
  */
 
 #include    <ctype.h>
@@ -98,6 +102,9 @@ __RCSID("$NetBSD: cond.c,v 1.67 2012/11/03 13:59:27 christos Exp $");
 #include    "hash.h"
 #include    "dir.h"
 #include    "buf.h"
+#ifdef ECB2G
+#include    "ecb2g.h"
+#endif
 
 /*
  * The parsing of conditional expressions is based on this grammar:
@@ -140,6 +147,26 @@ typedef enum {
     TOK_LPAREN, TOK_RPAREN, TOK_EOF, TOK_NONE, TOK_ERROR
 } Token;
 
+/*
+ * A conditional that parsed correctly is also kept as a tree of
+ * CondNodes, so that the next time the same line is met only its
+ * terms are evaluated again, without going through the grammar.
+ * A term that expands no variable and calls no function, such as "0"
+ * or "a" == "b", always has the same value and becomes a COND_CONST
+ * (as does an operator all of whose operands are constant).
+ */
+typedef enum {
+    COND_CONST, COND_TERM, COND_NOT, COND_AND, COND_OR
+} CondKind;
+
+typedef struct CondNode {
+    CondKind	    kind;
+    Token	    value;	/* COND_CONST: TOK_TRUE or TOK_FALSE */
+    char	    *term;	/* COND_TERM: the text of the term */
+    struct CondNode *left;	/* operands of COND_NOT, COND_AND, COND_OR */
+    struct CondNode *right;
+} CondNode;
+
 /*-
  * Structures to handle elegantly the different forms of #if's. The
  * last two fields are stored in condInvert and condDefProc, respectively.
@@ -154,6 +181,11 @@ static Boolean CondDoTarget(int, const char *);
 static Boolean CondDoCommands(int, const char *);
 static Boolean CondCvtArg(char *, double *);
 static Token CondToken(Boolean);
+static Token CondDoTerm(Boolean);
+static Token CondTerm(Boolean);
+static void CondCombine(CondKind, int);
+static void CondFreeNode(CondNode *);
+static Token CondEvalNode(CondNode *);
 static Token CondT(Boolean);
 static Token CondF(Boolean);
 static Token CondE(Boolean);
@@ -181,6 +213,30 @@ static Token	  condPushBack=TOK_NONE;	/* Single push-back token used in
 static unsigned int	cond_depth = 0;  	/* current .if nesting level */
 static unsigned int	cond_min_depth = 0;  	/* depth at makefile open */
 
+/*
+ * exists() is asked about the same files over and over by shared
+ * makefiles, so its answers, negative ones included, are kept until
+ * Cond_FlushExists. The value is the path found or NULL.
+ */
+static Hash_Table	condExists;
+static Boolean		condExistsInit = FALSE;
+
+/*
+ * The CondNode trees of the conditionals seen so far, by the form of
+ * the .if and the text of the expression. While a line is parsed, the
+ * trees of its terms and operators are built on condStack, from
+ * condBase up; condBroken is set if the parse went astray so that the
+ * stack does not hold exactly one tree at the end. condVolatile
+ * records whether the term being parsed expanded a variable or called
+ * a function.
+ */
+static Hash_Table	condTrees;
+static Boolean		condTreesInit = FALSE;
+static CondNode		**condStack = NULL;
+static int		condTop = 0, condBase = 0, condMax = 0;
+static Boolean		condBroken;
+static Boolean		condVolatile;
+
 static int
 istoken(const char *str, const char *tok, size_t len)
 {
@@ -397,21 +453,71 @@ CondDoMake(int argLen MAKE_ATTR_UNUSED, const char *arg)
 static Boolean
 CondDoExists(int argLen MAKE_ATTR_UNUSED, const char *arg)
 {
-    Boolean result;
+    Hash_Entry *he;
+    const char *cp;
     char    *path;
+    size_t  len;
+    unsigned int gen;
+    int     new;
 
-    path = Dir_FindFile(arg, dirSearchPath);
+    if (!condExistsInit) {
+	Hash_InitTable(&condExists, 0);
+	condExistsInit = TRUE;
+    }
+    he = Hash_CreateEntry(&condExists, arg, &new);
+    if (new) {
+	/* absolute names do not depend on the search path */
+	if (*arg == '/' &&
+	    (cp = ShCache_Get(SHC_EXISTS, arg, NULL, &len)) != NULL) {
+	    path = len > 0 ? bmake_strdup(cp) : NULL;
+#ifdef ECB2G
+	    ecb2gSnapshotExists(arg, path != NULL);
+#endif
+	} else {
+	    gen = ShCache_Generation();
+	    path = Dir_FindFile(arg, dirSearchPath);
+	    if (*arg == '/')
+		ShCache_Put(SHC_EXISTS, arg, NULL, gen, path ? path : "",
+			    path ? strlen(path) : 0);
+	}
+	Hash_SetValue(he, path);
+    }
+    path = Hash_GetValue(he);
     if (DEBUG(COND)) {
-	fprintf(debug_file, "exists(%s) result is \"%s\"\n",
-	       arg, path ? path : "");
+	fprintf(debug_file, "exists(%s) result is \"%s\"%s\n",
+	       arg, path ? path : "", new ? "" : " (cached)");
     }    
-    if (path != NULL) {
-	result = TRUE;
-	free(path);
-    } else {
-	result = FALSE;
-    }
-    return (result);
+    return (path != NULL);
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * Cond_FlushExists --
+ *	Forget the results of earlier exists() calls. Called when
+ *	the search path changes and whenever a target has been made,
+ *	since either may change the answer.
+ *
+ * Results:
+ *	None.
+ *
+ * Side Effects:
+ *	The next exists() of each file looks for it again.
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+Cond_FlushExists(void)
+{
+    Hash_Search search;
+    Hash_Entry *he;
+
+    if (!condExistsInit || condExists.numEntries == 0)
+	return;
+    for (he = Hash_EnumFirst(&condExists, &search); he != NULL;
+	 he = Hash_EnumNext(&search))
+	free(Hash_GetValue(he));
+    Hash_DeleteTable(&condExists);
+    Hash_InitTable(&condExists, 0);
 }
 
 /*-
@@ -560,6 +666,7 @@ CondGetString(Boolean doEval, Boolean *quoted, void **freeIt)
 		Buf_AddByte(&buf, *condExpr);
 	    break;
 	case '$':
+	    condVolatile = TRUE;
 	    /* if we are in quotes, then an undefined variable is ok */
 	    str = Var_Parse(condExpr, VAR_CMD, (qt ? 0 : doEval),
 			    &len, freeIt);
@@ -860,6 +967,9 @@ compare_function(Boolean doEval)
     char *cp = condExpr;
     char *cp1;
 
+    /* everything but a number depends on the state of the makefile */
+    condVolatile |= !isdigit((unsigned char)cp[0]) && !strchr("+-", cp[0]);
+
     for (fn_def = fn_defs; fn_def->fn_name != NULL; fn_def++) {
 	if (!istoken(cp, fn_def->fn_name, fn_def->fn_name_len))
 	    continue;
@@ -963,13 +1073,175 @@ CondToken(Boolean doEval)
     case '\0':
 	return TOK_EOF;
 
-    case '"':
-    case '$':
+    default:
+	return CondTerm(doEval);
+    }
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * CondDoTerm --
+ *	Evaluate the terminal symbol at condExpr.
+ *
+ * Results:
+ *	TOK_TRUE, TOK_FALSE or TOK_ERROR.
+ *
+ * Side Effects:
+ *	The term is consumed.
+ *
+ *-----------------------------------------------------------------------
+ */
+static Token
+CondDoTerm(Boolean doEval)
+{
+    if (*condExpr == '"' || *condExpr == '$')
 	return compare_expression(doEval);
+    return compare_function(doEval);
+}
 
-    default:
-	return compare_function(doEval);
+/*-
+ *-----------------------------------------------------------------------
+ * CondTerm --
+ *	Evaluate the terminal symbol at condExpr and push its node on
+ *	condStack: its value if that cannot change, else its text.
+ *
+ * Results:
+ *	TOK_TRUE, TOK_FALSE or TOK_ERROR.
+ *
+ * Side Effects:
+ *	The term is consumed.
+ *
+ *-----------------------------------------------------------------------
+ */
+static Token
+CondTerm(Boolean doEval)
+{
+    Boolean sv_condVolatile = condVolatile;
+    char *start = condExpr;
+    CondNode *n;
+    Token t;
+
+    condVolatile = FALSE;
+    t = CondDoTerm(doEval);
+
+    n = bmake_malloc(sizeof(*n));
+    n->left = n->right = NULL;
+    n->term = NULL;
+    /* without doEval, t is not the value of the term */
+    if (doEval && !condVolatile && t != TOK_ERROR) {
+	n->kind = COND_CONST;
+	n->value = t;
+    } else {
+	n->kind = COND_TERM;
+	n->term = bmake_strndup(start, condExpr - start);
     }
+    if (condTop == condMax) {
+	condMax = condMax ? condMax * 2 : 16;
+	condStack = bmake_realloc(condStack, condMax * sizeof(*condStack));
+    }
+    condStack[condTop++] = n;
+
+    condVolatile |= sv_condVolatile;
+    return t;
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * CondCombine --
+ *	Replace the operands on condStack above base by a node of
+ *	the given operator.
+ *
+ * Results:
+ *	None.
+ *
+ * Side Effects:
+ *	condBroken is set if the operands are not all there, as when
+ *	the parse of one of them failed.
+ *
+ *-----------------------------------------------------------------------
+ */
+static void
+CondCombine(CondKind kind, int base)
+{
+    CondNode *n, *l, *r;
+
+    if (condTop - base != (kind == COND_NOT ? 1 : 2)) {
+	condBroken = TRUE;
+	return;
+    }
+    r = kind == COND_NOT ? NULL : condStack[--condTop];
+    l = condStack[--condTop];
+
+    n = bmake_malloc(sizeof(*n));
+    n->kind = kind;
+    n->term = NULL;
+    n->left = l;
+    n->right = r;
+    if (l->kind == COND_CONST && (r == NULL || r->kind == COND_CONST)) {
+	n->value = CondEvalNode(n);
+	n->kind = COND_CONST;
+	n->left = n->right = NULL;
+	CondFreeNode(l);
+	if (r != NULL)
+	    CondFreeNode(r);
+    }
+    condStack[condTop++] = n;
+}
+
+static void
+CondFreeNode(CondNode *n)
+{
+    if (n->left != NULL)
+	CondFreeNode(n->left);
+    if (n->right != NULL)
+	CondFreeNode(n->right);
+    free(n->term);
+    free(n);
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * CondEvalNode --
+ *	Evaluate a parsed conditional, in the same order and with the
+ *	same short-circuiting as CondE, CondF and CondT would. Operands
+ *	those would only parse without evaluating are skipped.
+ *
+ * Results:
+ *	TOK_TRUE, TOK_FALSE or TOK_ERROR.
+ *
+ * Side Effects:
+ *	condExpr is used to evaluate the terms.
+ *
+ *-----------------------------------------------------------------------
+ */
+static Token
+CondEvalNode(CondNode *n)
+{
+    Token t;
+
+    switch (n->kind) {
+    case COND_CONST:
+	return n->value;
+    case COND_TERM:
+	condExpr = n->term;
+	return CondDoTerm(TRUE);
+    case COND_NOT:
+	t = CondEvalNode(n->left);
+	if (t == TOK_TRUE || t == TOK_FALSE)
+	    t = !t;
+	return t;
+    case COND_AND:
+	t = CondEvalNode(n->left);
+	if (t == TOK_TRUE)
+	    t = CondEvalNode(n->right);
+	return t;
+    case COND_OR:
+	t = CondEvalNode(n->left);
+	if (t == TOK_FALSE)
+	    t = CondEvalNode(n->right);
+	return t;
+    }
+    return TOK_ERROR;
 }
 
 /*-
@@ -1013,7 +1285,10 @@ CondT(Boolean doEval)
 	    }
 	}
     } else if (t == TOK_NOT) {
+	int base = condTop;
+
 	t = CondT(doEval);
+	CondCombine(COND_NOT, base);
 	if (t == TOK_TRUE) {
 	    t = TOK_FALSE;
 	} else if (t == TOK_FALSE) {
@@ -1041,6 +1316,7 @@ static Token
 CondF(Boolean doEval)
 {
     Token   l, o;
+    int	    base = condTop;
 
     l = CondT(doEval);
     if (l != TOK_ERROR) {
@@ -1059,6 +1335,7 @@ CondF(Boolean doEval)
 	    } else {
 		(void)CondF(FALSE);
 	    }
+	    CondCombine(COND_AND, base);
 	} else {
 	    /*
 	     * F -> T
@@ -1087,6 +1364,7 @@ static Token
 CondE(Boolean doEval)
 {
     Token   l, o;
+    int	    base = condTop;
 
     l = CondF(doEval);
     if (l != TOK_ERROR) {
@@ -1106,6 +1384,7 @@ CondE(Boolean doEval)
 	    } else {
 		(void)CondE(FALSE);
 	    }
+	    CondCombine(COND_OR, base);
 	} else {
 	    /*
 	     * E -> F
@@ -1141,6 +1420,15 @@ Cond_EvalExpression(const struct If *info, char *line, Boolean *value, int eprin
     const struct If *sv_if_info = if_info;
     char *sv_condExpr = condExpr;
     Token sv_condPushBack = condPushBack;
+    Boolean sv_condVolatile = condVolatile;
+    Boolean sv_condBroken = condBroken;
+    int sv_condBase = condBase;
+    Buffer key;
+    char *name;
+    Hash_Entry *he;
+    CondNode *tree;
+    Token t;
+    int new;
     int rval;
 
     while (*line == ' ' || *line == '\t')
@@ -1157,8 +1445,47 @@ Cond_EvalExpression(const struct If *info, char *line, Boolean *value, int eprin
     if_info = info != NULL ? info : ifs + 4;
     condExpr = line;
     condPushBack = TOK_NONE;
-
-    rval = do_Cond_EvalExpression(value);
+    condVolatile = FALSE;
+    condBroken = FALSE;
+    condBase = condTop;
+
+    /* the default function of a symbol depends on the form of .if */
+    if (!condTreesInit) {
+	Hash_InitTable(&condTrees, 0);
+	condTreesInit = TRUE;
+    }
+    Buf_Init(&key, 0);
+    Buf_AddBytes(&key, strlen(if_info->form), if_info->form);
+    Buf_AddByte(&key, ':');
+    Buf_AddBytes(&key, strlen(line), line);
+    name = Buf_GetAll(&key, NULL);
+
+    if ((he = Hash_FindEntry(&condTrees, name)) != NULL) {
+	if (DEBUG(COND))
+	    fprintf(debug_file, "condition (%s) evaluated from its tree\n",
+		    line);
+	t = CondEvalNode(Hash_GetValue(he));
+	rval = COND_INVALID;
+	if (t == TOK_TRUE || t == TOK_FALSE) {
+	    *value = t;
+	    rval = COND_PARSE;
+	}
+    } else {
+	rval = do_Cond_EvalExpression(value);
+	tree = NULL;
+	if (rval == COND_PARSE && !condBroken && condTop == condBase + 1)
+	    tree = condStack[--condTop];
+	while (condTop > condBase)
+	    CondFreeNode(condStack[--condTop]);
+	if (tree != NULL) {
+	    he = Hash_CreateEntry(&condTrees, name, &new);
+	    if (new)
+		Hash_SetValue(he, tree);
+	    else
+		CondFreeNode(tree);
+	}
+    }
+    Buf_Destroy(&key, TRUE);
 
     if (rval == COND_INVALID && eprint)
 	Parse_Error(PARSE_FATAL, "Malformed conditional (%s)", line);
@@ -1166,6 +1493,9 @@ Cond_EvalExpression(const struct If *info, char *line, Boolean *value, int eprin
     if_info = sv_if_info;
     condExpr = sv_condExpr;
     condPushBack = sv_condPushBack;
+    condVolatile = sv_condVolatile | condVolatile;
+    condBroken = sv_condBroken;
+    condBase = sv_condBase;
 
     return rval;
 }
@@ -0,0 +1,760 @@
+/*
+ * Copyright (c) 2014, Juniper Networks, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*-
+ * digest.c --
+ *	Out-of-date checks by file contents.
+ *
+ *	When MAKE_CONTENT_HASH is set, make keeps a database in its
+ *	.OBJDIR (or at the path the variable gives) of the digests of
+ *	the files it looked at and, for each target it made, one digest
+ *	of the names and contents of its sources at the time. A target
+ *	older than its sources is still up-to-date when their contents
+ *	are what it was made from, so sources that were only touched,
+ *	or checked out again, cause no rebuild. The same goes for the
+ *	files a .meta file says the target read.
+ *
+ *	As in a git index, the digest of a file is only computed again
+ *	when its inode, size or times change, and is not kept while the
+ *	file may still change within the same second.
+ *
+ *	A translation makes nothing: emake remakes what it is given,
+ *	so nothing is noted for the targets translated, and a target
+ *	one of whose sources was translated is out-of-date as before.
+ *
+ *	The database is read at startup and written back at exit, under
+ *	a lock, keeping whatever other makes wrote meanwhile for the
+ *	files and targets this one did not note.
+ *
+ * Interface:
+ *	Digest_Init		Read the database.
+ *
+ *	Digest_SourcesUnchanged	Whether the sources of a target are
+ *				still those it was made from.
+ *
+ *	Digest_Seed		Note the sources of an up-to-date target.
+ *
+ *	Digest_Made		Note the sources of a target just made.
+ *
+ *	Digest_InputUnchanged	Whether a file the target read is
+ *				unchanged since.
+ *
+ *	Digest_InputSeen	Note such a file.
+ *
+ *	Digest_Data		The digest of some bytes.
+ *
+ *	Digest_File		The digest of a plain file, from the
+ *				database if it has it.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "make.h"
+#ifdef ECB2G
+#include "ecb2g.h"
+#endif
+
+#define DIG_ENV		"MAKE_CONTENT_HASH"
+#define DIG_FILE	".make.digests"
+#define DIG_MAGIC	"make-digests 1\n"
+#define DIG_END		"end\n"
+
+struct dig_file {
+	uint64_t ino, size, mtime, ctime;	/* when the digest was taken */
+	uint64_t digest;
+	Boolean	dirty;			/* to be written back */
+};
+
+struct dig_target {
+	Boolean	hassig;
+	uint64_t sig;			/* of the sources it was made from */
+	Hash_Table *inputs;		/* name -> uint64_t digest, or NULL */
+	Boolean	dirty;			/* to be written back, or removed */
+};
+
+static Hash_Table dig_files;		/* absolute name -> struct dig_file */
+static Hash_Table dig_targets;		/* absolute name -> struct dig_target */
+static char *dig_path = NULL;		/* the database, NULL if none */
+static Boolean dig_dirty = FALSE;
+static pid_t dig_pid;
+
+/*
+ * XXH64, in native byte order: the database is only read on the host
+ * that wrote it.
+ */
+#define XXH_P1	11400714785074694791ULL
+#define XXH_P2	14029467366897019727ULL
+#define XXH_P3	1609587929392839161ULL
+#define XXH_P4	9650029242287828579ULL
+#define XXH_P5	2870177450012600261ULL
+
+#define XXH_ROTL(x, r)	(((x) << (r)) | ((x) >> (64 - (r))))
+
+static uint64_t
+xxh_round(uint64_t acc, uint64_t in)
+{
+	acc += in * XXH_P2;
+	acc = XXH_ROTL(acc, 31);
+	return acc * XXH_P1;
+}
+
+static uint64_t
+xxh_merge(uint64_t acc, uint64_t v)
+{
+	acc ^= xxh_round(0, v);
+	return acc * XXH_P1 + XXH_P4;
+}
+
+static uint64_t
+xxh_read64(const unsigned char *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static uint64_t
+xxh64(const void *data, size_t len, uint64_t seed)
+{
+	const unsigned char *p = data, *end = p + len;
+	uint64_t h, v1, v2, v3, v4;
+	uint32_t w;
+
+	if (len >= 32) {
+		v1 = seed + XXH_P1 + XXH_P2;
+		v2 = seed + XXH_P2;
+		v3 = seed;
+		v4 = seed - XXH_P1;
+		do {
+			v1 = xxh_round(v1, xxh_read64(p));
+			v2 = xxh_round(v2, xxh_read64(p + 8));
+			v3 = xxh_round(v3, xxh_read64(p + 16));
+			v4 = xxh_round(v4, xxh_read64(p + 24));
+			p += 32;
+		} while (p <= end - 32);
+		h = XXH_ROTL(v1, 1) + XXH_ROTL(v2, 7) + XXH_ROTL(v3, 12) +
+		    XXH_ROTL(v4, 18);
+		h = xxh_merge(h, v1);
+		h = xxh_merge(h, v2);
+		h = xxh_merge(h, v3);
+		h = xxh_merge(h, v4);
+	} else
+		h = seed + XXH_P5;
+	h += (uint64_t)len;
+
+	for (; p + 8 <= end; p += 8) {
+		h ^= xxh_round(0, xxh_read64(p));
+		h = XXH_ROTL(h, 27) * XXH_P1 + XXH_P4;
+	}
+	if (p + 4 <= end) {
+		memcpy(&w, p, sizeof(w));
+		h ^= (uint64_t)w * XXH_P1;
+		h = XXH_ROTL(h, 23) * XXH_P2 + XXH_P3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		h ^= (uint64_t)*p * XXH_P5;
+		h = XXH_ROTL(h, 11) * XXH_P1;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_P2;
+	h ^= h >> 29;
+	h *= XXH_P3;
+	h ^= h >> 32;
+	return h;
+}
+
+/*
+ * Names are kept absolute, so that the database may be shared and
+ * the makefiles may move us to another .OBJDIR.
+ */
+static const char *
+dig_name(const char *name, char *buf, size_t bufsz)
+{
+	char cwd[MAXPATHLEN];
+
+	if (*name == '/')
+		return name;
+	if (getcwd(cwd, sizeof(cwd)) == NULL ||
+	    (size_t)snprintf(buf, bufsz, "%s/%s", cwd, name) >= bufsz)
+		return NULL;
+	return buf;
+}
+
+static Boolean
+dig_hash_file(const char *name, const struct stat *st, uint64_t *dp)
+{
+	Buffer buf;
+	char chunk[BUFSIZ];
+	ssize_t n;
+	int fd;
+
+	if ((fd = open(name, O_RDONLY)) == -1)
+		return FALSE;
+	PROF_COUNT(PROF_DIGESTS);
+	prof_count[PROF_DIGEST_BYTES] += st->st_size;
+#ifdef HAVE_MMAP
+	if (st->st_size > 0) {
+		void *map = mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE,
+		    fd, 0);
+
+		if (map != MAP_FAILED) {
+			*dp = xxh64(map, st->st_size, 0);
+			(void)munmap(map, st->st_size);
+			(void)close(fd);
+			return TRUE;
+		}
+	}
+#endif
+	Buf_Init(&buf, 0);
+	while ((n = read(fd, chunk, sizeof(chunk))) > 0 ||
+	    (n == -1 && errno == EINTR)) {
+		if (n > 0)
+			Buf_AddBytes(&buf, n, (Byte *)chunk);
+	}
+	(void)close(fd);
+	if (n == 0)
+		*dp = xxh64(Buf_GetAll(&buf, NULL), Buf_Size(&buf), 0);
+	Buf_Destroy(&buf, TRUE);
+	return n == 0;
+}
+
+/*
+ * The digest of a plain file, computed again only if it changed.
+ */
+static Boolean
+dig_file(const char *name, const struct stat *st, uint64_t *dp)
+{
+	char buf[MAXPATHLEN];
+	struct dig_file *f;
+	Hash_Entry *he;
+	time_t racy;
+
+	if ((name = dig_name(name, buf, sizeof(buf))) == NULL)
+		return FALSE;
+	he = Hash_FindEntry(&dig_files, name);
+	if (he != NULL) {
+		f = Hash_GetValue(he);
+		if (f->ino == (uint64_t)st->st_ino &&
+		    f->size == (uint64_t)st->st_size &&
+		    f->mtime == (uint64_t)st->st_mtime &&
+		    f->ctime == (uint64_t)st->st_ctime) {
+			*dp = f->digest;
+			return TRUE;
+		}
+	}
+	if (!dig_hash_file(name, st, dp))
+		return FALSE;
+
+	/*
+	 * A change within the same second as the one we saw would leave
+	 * the times alone; keep the digest only once that cannot happen.
+	 */
+	racy = time(NULL) - 1;
+	if (st->st_mtime >= racy || st->st_ctime >= racy) {
+		if (he != NULL) {
+			free(Hash_GetValue(he));
+			Hash_DeleteEntry(&dig_files, he);
+		}
+		return TRUE;
+	}
+	if (he == NULL) {
+		he = Hash_CreateEntry(&dig_files, name, NULL);
+		Hash_SetValue(he, bmake_malloc(sizeof(*f)));
+	}
+	f = Hash_GetValue(he);
+	f->ino = st->st_ino;
+	f->size = st->st_size;
+	f->mtime = st->st_mtime;
+	f->ctime = st->st_ctime;
+	f->digest = *dp;
+	f->dirty = dig_dirty = TRUE;
+	return TRUE;
+}
+
+/*
+ * One digest of the names and contents of the sources of gn, in
+ * order. Fails if one of them is not a plain file: its contents would
+ * not tell whether it changed.
+ */
+static Boolean
+dig_sources(GNode *gn, uint64_t *sigp)
+{
+	Buffer buf;
+	LstNode ln;
+	GNode *cgn;
+	struct stat st;
+	const char *name;
+	uint64_t d;
+	Boolean ok = TRUE;
+
+	Buf_Init(&buf, 0);
+	for (ln = Lst_First(gn->children); ln != NULL; ln = Lst_Succ(ln)) {
+		cgn = (GNode *)Lst_Datum(ln);
+		if (cgn->type & (OP_USE|OP_USEBEFORE|OP_WAIT))
+			continue;
+		name = cgn->path ? cgn->path : cgn->name;
+#ifdef ECB2G
+		if (ecb2gEnabled() && cgn->made == MADE) {
+			ok = FALSE;
+			break;
+		}
+#endif
+		if ((cgn->type & (OP_PHONY|OP_EXEC|OP_FORCE|OP_JOIN|OP_ARCHV)) ||
+		    stat(name, &st) == -1 || !S_ISREG(st.st_mode) ||
+		    !dig_file(name, &st, &d)) {
+			ok = FALSE;
+			break;
+		}
+		Buf_AddBytes(&buf, strlen(name) + 1, (const Byte *)name);
+		Buf_AddBytes(&buf, sizeof(d), (Byte *)&d);
+	}
+	if (ok)
+		*sigp = xxh64(Buf_GetAll(&buf, NULL), Buf_Size(&buf), 0);
+	Buf_Destroy(&buf, TRUE);
+	return ok;
+}
+
+static struct dig_target *
+dig_target(GNode *gn, Boolean create)
+{
+	char buf[MAXPATHLEN];
+	const char *name;
+	struct dig_target *t;
+	Hash_Entry *he;
+	Boolean new;
+
+	name = dig_name(gn->path ? gn->path : gn->name, buf, sizeof(buf));
+	if (name == NULL)
+		return NULL;
+	if (!create) {
+		he = Hash_FindEntry(&dig_targets, name);
+		return he ? Hash_GetValue(he) : NULL;
+	}
+	he = Hash_CreateEntry(&dig_targets, name, &new);
+	if (new) {
+		t = bmake_malloc(sizeof(*t));
+		t->hassig = FALSE;
+		t->inputs = NULL;
+		t->dirty = FALSE;
+		Hash_SetValue(he, t);
+	}
+	return Hash_GetValue(he);
+}
+
+static void
+dig_free_inputs(struct dig_target *t)
+{
+	Hash_Search search;
+	Hash_Entry *he;
+
+	if (t->inputs == NULL)
+		return;
+	for (he = Hash_EnumFirst(t->inputs, &search); he != NULL;
+	    he = Hash_EnumNext(&search))
+		free(Hash_GetValue(he));
+	Hash_DeleteTable(t->inputs);
+	free(t->inputs);
+	t->inputs = NULL;
+}
+
+/*
+ * Merge a database into ours. Entries we changed ourselves win.
+ */
+static void
+dig_read(char *cp, char *end)
+{
+	struct dig_target *t = NULL;	/* the target of I records */
+	struct dig_file *f;
+	Hash_Entry *he;
+	unsigned long long n[4];
+	uint64_t d;
+	char *nl, sig[32];
+	int off;
+	Boolean new;
+
+	if ((size_t)(end - cp) < sizeof(DIG_MAGIC DIG_END) - 1 ||
+	    memcmp(cp, DIG_MAGIC, sizeof(DIG_MAGIC) - 1) != 0 ||
+	    memcmp(end - (sizeof(DIG_END) - 1), DIG_END,
+		sizeof(DIG_END) - 1) != 0)
+		return;			/* not ours, or cut short */
+	cp += sizeof(DIG_MAGIC) - 1;
+	end -= sizeof(DIG_END) - 1;
+
+	for (; cp < end && (nl = memchr(cp, '\n', end - cp)) != NULL;
+	    cp = nl + 1) {
+		*nl = '\0';
+		off = 0;
+		switch (*cp) {
+		case 'F':
+			if (sscanf(cp, "F %llu %llu %llu %llu %" SCNx64 " %n",
+			    &n[0], &n[1], &n[2], &n[3], &d, &off) < 5 ||
+			    off == 0)
+				break;
+			he = Hash_CreateEntry(&dig_files, cp + off, &new);
+			if (new)
+				Hash_SetValue(he, bmake_malloc(sizeof(*f)));
+			else if (((struct dig_file *)Hash_GetValue(he))->dirty)
+				break;
+			f = Hash_GetValue(he);
+			f->ino = n[0];
+			f->size = n[1];
+			f->mtime = n[2];
+			f->ctime = n[3];
+			f->digest = d;
+			f->dirty = FALSE;
+			break;
+		case 'T':
+			t = NULL;
+			if (sscanf(cp, "T %31s %n", sig, &off) < 1 || off == 0)
+				break;
+			he = Hash_CreateEntry(&dig_targets, cp + off, &new);
+			if (new) {
+				t = bmake_malloc(sizeof(*t));
+				t->inputs = NULL;
+				Hash_SetValue(he, t);
+			} else {
+				t = Hash_GetValue(he);
+				if (t->dirty) {
+					t = NULL;
+					break;
+				}
+				dig_free_inputs(t);
+			}
+			t->hassig = *sig != '-';
+			t->sig = strtoull(sig, NULL, 16);
+			t->dirty = FALSE;
+			break;
+		case 'I':
+			if (t == NULL ||
+			    sscanf(cp, "I %" SCNx64 " %n", &d, &off) < 1 ||
+			    off == 0)
+				break;
+			if (t->inputs == NULL) {
+				t->inputs = bmake_malloc(sizeof(Hash_Table));
+				Hash_InitTable(t->inputs, 0);
+			}
+			he = Hash_CreateEntry(t->inputs, cp + off, &new);
+			if (new)
+				Hash_SetValue(he, bmake_malloc(sizeof(d)));
+			*(uint64_t *)Hash_GetValue(he) = d;
+			break;
+		}
+	}
+}
+
+/*
+ * Read the whole database from fd, which is locked.
+ */
+static void
+dig_load(int fd)
+{
+	struct stat st;
+	char *buf;
+	ssize_t n;
+	size_t len = 0;
+
+	if (fstat(fd, &st) == -1 || st.st_size == 0)
+		return;
+	buf = bmake_malloc(st.st_size);
+	while (len < (size_t)st.st_size &&
+	    ((n = read(fd, buf + len, st.st_size - len)) > 0 ||
+		(n == -1 && errno == EINTR))) {
+		if (n > 0)
+			len += n;
+	}
+	dig_read(buf, buf + len);
+	free(buf);
+}
+
+static int
+dig_lock(int fd, int type)
+{
+	struct flock fl;
+
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = type;
+	fl.l_whence = SEEK_SET;
+	while (fcntl(fd, F_SETLKW, &fl) == -1) {
+		if (errno != EINTR)
+			return -1;
+	}
+	return 0;
+}
+
+static void
+dig_add(Buffer *bp, const char *fmt, ...)
+{
+	char line[MAXPATHLEN + 128];
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
+	if (n > 0 && (size_t)n < sizeof(line))
+		Buf_AddBytes(bp, n, (Byte *)line);
+}
+
+/*
+ * Write the database back, with what other makes added since we read
+ * it.
+ */
+static void
+dig_end(void)
+{
+	Hash_Search search, isearch;
+	Hash_Entry *he, *ihe;
+	struct dig_file *f;
+	struct dig_target *t;
+	Buffer buf;
+	Byte *data;
+	int fd, len, off;
+	ssize_t n;
+
+	if (!dig_dirty || getpid() != dig_pid)
+		return;
+	if ((fd = open(dig_path, O_RDWR|O_CREAT, 0666)) == -1)
+		return;
+	if (dig_lock(fd, F_WRLCK) == -1) {
+		(void)close(fd);
+		return;
+	}
+	dig_load(fd);
+
+	Buf_Init(&buf, 0);
+	Buf_AddBytes(&buf, sizeof(DIG_MAGIC) - 1, (const Byte *)DIG_MAGIC);
+	for (he = Hash_EnumFirst(&dig_files, &search); he != NULL;
+	    he = Hash_EnumNext(&search)) {
+		f = Hash_GetValue(he);
+		if (strchr(he->name, '\n') == NULL)
+			dig_add(&buf, "F %llu %llu %llu %llu %016" PRIx64 " %s\n",
+			    (unsigned long long)f->ino,
+			    (unsigned long long)f->size,
+			    (unsigned long long)f->mtime,
+			    (unsigned long long)f->ctime, f->digest, he->name);
+	}
+	for (he = Hash_EnumFirst(&dig_targets, &search); he != NULL;
+	    he = Hash_EnumNext(&search)) {
+		t = Hash_GetValue(he);
+		if ((!t->hassig && t->inputs == NULL) ||
+		    strchr(he->name, '\n') != NULL)
+			continue;
+		if (t->hassig)
+			dig_add(&buf, "T %016" PRIx64 " %s\n", t->sig, he->name);
+		else
+			dig_add(&buf, "T - %s\n", he->name);
+		if (t->inputs == NULL)
+			continue;
+		for (ihe = Hash_EnumFirst(t->inputs, &isearch); ihe != NULL;
+		    ihe = Hash_EnumNext(&isearch))
+			if (strchr(ihe->name, '\n') == NULL)
+				dig_add(&buf, "I %016" PRIx64 " %s\n",
+				    *(uint64_t *)Hash_GetValue(ihe), ihe->name);
+	}
+	Buf_AddBytes(&buf, sizeof(DIG_END) - 1, (const Byte *)DIG_END);
+
+	data = Buf_GetAll(&buf, &len);
+	if (ftruncate(fd, 0) == 0) {
+		for (off = 0; off < len; off += n) {
+			n = pwrite(fd, data + off, len - off, off);
+			if (n == -1 && errno == EINTR)
+				n = 0;
+			else if (n <= 0)
+				break;
+		}
+	}
+	Buf_Destroy(&buf, TRUE);
+	(void)close(fd);		/* and the lock with it */
+}
+
+void
+Digest_Init(const char *objdir)
+{
+	const char *env;
+	char path[MAXPATHLEN];
+	int fd;
+
+	if ((env = getenv(DIG_ENV)) == NULL || *env == '\0')
+		return;
+	if (*env == '/')
+		snprintf(path, sizeof(path), "%s", env);
+	else
+		snprintf(path, sizeof(path), "%s/%s", objdir, DIG_FILE);
+	dig_path = bmake_strdup(path);
+	Hash_InitTable(&dig_files, 0);
+	Hash_InitTable(&dig_targets, 0);
+	if ((fd = open(dig_path, O_RDONLY)) != -1) {
+		if (dig_lock(fd, F_RDLCK) == 0)
+			dig_load(fd);
+		(void)close(fd);
+	}
+	dig_pid = getpid();
+	atexit(dig_end);
+	if (DEBUG(MAKE))
+		fprintf(debug_file, "Content digests in %s\n", dig_path);
+}
+
+Boolean
+Digest_SourcesUnchanged(GNode *gn)
+{
+	struct dig_target *t;
+	uint64_t sig;
+
+	if (dig_path == NULL || gn->mtime == 0 ||
+	    (t = dig_target(gn, FALSE)) == NULL || !t->hassig ||
+	    !dig_sources(gn, &sig) || sig != t->sig)
+		return FALSE;
+	if (DEBUG(MAKE))
+		fprintf(debug_file, "sources unchanged...");
+	return TRUE;
+}
+
+/*
+ * Note the sources of gn unless noted already. With inputs FALSE,
+ * what it read is kept: that was just noted by meta_oodate.
+ */
+static void
+dig_note(GNode *gn, Boolean inputs)
+{
+	struct dig_target *t;
+	uint64_t sig;
+	Boolean ok;
+
+	if ((t = dig_target(gn, TRUE)) == NULL)
+		return;
+	ok = dig_sources(gn, &sig);
+	if (ok == t->hassig && (!ok || sig == t->sig) &&
+	    (!inputs || t->inputs == NULL))
+		return;
+	t->hassig = ok;
+	t->sig = sig;
+	if (inputs)
+		dig_free_inputs(t);
+	t->dirty = dig_dirty = TRUE;
+}
+
+/*
+ * A target up-to-date by its time was made from what its sources hold
+ * now, whoever made it.
+ */
+void
+Digest_Seed(GNode *gn)
+{
+	if (dig_path == NULL || gn->mtime == 0 || Lst_IsEmpty(gn->children))
+		return;
+	dig_note(gn, FALSE);
+}
+
+void
+Digest_Made(GNode *gn)
+{
+	if (dig_path == NULL || NoExecute(gn) || Lst_IsEmpty(gn->children))
+		return;
+#ifdef ECB2G
+	if (ecb2gEnabled())
+		return;
+#endif
+	/* what it read last time need not be what it read now */
+	dig_note(gn, TRUE);
+}
+
+Boolean
+Digest_InputUnchanged(GNode *gn, const char *name, const struct stat *st)
+{
+	char buf[MAXPATHLEN];
+	struct dig_target *t;
+	Hash_Entry *he;
+	uint64_t d;
+
+	if (dig_path == NULL || !S_ISREG(st->st_mode) ||
+	    (t = dig_target(gn, FALSE)) == NULL || t->inputs == NULL ||
+	    (name = dig_name(name, buf, sizeof(buf))) == NULL ||
+	    (he = Hash_FindEntry(t->inputs, name)) == NULL ||
+	    !dig_file(name, st, &d) || d != *(uint64_t *)Hash_GetValue(he))
+		return FALSE;
+	if (DEBUG(META))
+		fprintf(debug_file, "%s: unchanged since %s was made\n",
+		    name, gn->name);
+	return TRUE;
+}
+
+void
+Digest_InputSeen(GNode *gn, const char *name, const struct stat *st)
+{
+	char buf[MAXPATHLEN];
+	struct dig_target *t;
+	Hash_Entry *he;
+	uint64_t d;
+	Boolean new;
+
+	if (dig_path == NULL || !S_ISREG(st->st_mode) ||
+	    (name = dig_name(name, buf, sizeof(buf))) == NULL ||
+	    !dig_file(name, st, &d) || (t = dig_target(gn, TRUE)) == NULL)
+		return;
+	if (t->inputs == NULL) {
+		t->inputs = bmake_malloc(sizeof(Hash_Table));
+		Hash_InitTable(t->inputs, 0);
+	}
+	he = Hash_CreateEntry(t->inputs, name, &new);
+	if (new)
+		Hash_SetValue(he, bmake_malloc(sizeof(d)));
+	else if (*(uint64_t *)Hash_GetValue(he) == d)
+		return;
+	*(uint64_t *)Hash_GetValue(he) = d;
+	t->dirty = dig_dirty = TRUE;
+}
+
+uint64_t
+Digest_Data(const void *data, size_t len, uint64_t seed)
+{
+	return xxh64(data, len, seed);
+}
+
+Boolean
+Digest_File(const char *name, const struct stat *st, uint64_t *dp)
+{
+	if (dig_path == NULL)
+		return dig_hash_file(name, st, dp);
+	return dig_file(name, st, dp);
+}
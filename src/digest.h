@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2014, Juniper Networks, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*-
+ * digest.h --
+ *	Definitions for out-of-date checks by file contents.
+ */
+
+#ifndef _DIGEST_H_
+#define _DIGEST_H_
+
+#include <stdint.h>
+
+struct stat;
+struct GNode;
+
+void Digest_Init(const char *);
+Boolean Digest_SourcesUnchanged(struct GNode *);
+void Digest_Seed(struct GNode *);
+void Digest_Made(struct GNode *);
+Boolean Digest_InputUnchanged(struct GNode *, const char *,
+    const struct stat *);
+void Digest_InputSeen(struct GNode *, const char *, const struct stat *);
+uint64_t Digest_Data(const void *, size_t, uint64_t);
+Boolean Digest_File(const char *, const struct stat *, uint64_t *);
+
+#endif /* _DIGEST_H_ */
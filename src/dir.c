@@ -146,6 +146,9 @@ __RCSID("$NetBSD: dir.c,v 1.67 2013/03/05 22:01:43 christos Exp $");
 #include "hash.h"
 #include "dir.h"
 #include "job.h"
+#ifdef ECB2G
+#include "ecb2g.h"
+#endif
 
 /*
  *	A search path consists of a Lst of Path structures. A Path structure
@@ -255,6 +258,24 @@ static char *DirLookup(Path *, const char *, const char *, Boolean);
 static char *DirLookupSubdir(Path *, const char *);
 static char *DirFindDot(Boolean, const char *, const char *);
 static char *DirLookupAbs(Path *, const char *, const char *);
+static int DirStat(const char *, struct stat *);
+
+/*
+ * All of this module's stat(2) calls go through here so they can be
+ * counted, and noted as inputs of a translation snapshot.
+ */
+static int
+DirStat(const char *name, struct stat *st)
+{
+    int rc;
+
+    PROF_COUNT(PROF_STATS);
+    rc = stat(name, st);
+#ifdef ECB2G
+    ecb2gSnapshotFile(name, rc == 0 ? st : NULL);
+#endif
+    return rc;
+}
 
 /*-
  *-----------------------------------------------------------------------
@@ -393,6 +414,7 @@ Dir_SetPATH(void)
     Path *p;
     Boolean	  hasLastDot = FALSE;	/* true we should search dot last */
 
+    Cond_FlushExists();			/* exists() searches this path */
     Var_Delete(".PATH", VAR_GLOBAL);
     
     if (Lst_Open(dirSearchPath) == SUCCESS) {
@@ -535,8 +557,10 @@ DirMatchFiles(const char *pattern, Path *p, Lst expansions)
     Hash_Search	  search;   	/* Index into the directory's table */
     Hash_Entry	  *entry;   	/* Current entry in the table */
     Boolean 	  isDot;    	/* TRUE if the directory being searched is . */
+    StrPattern	  spat;
 
     isDot = (*p->name == '.' && p->name[1] == '\0');
+    Str_PatternInit(&spat, pattern);
 
     for (entry = Hash_EnumFirst(&p->files, &search);
 	 entry != NULL;
@@ -548,7 +572,7 @@ DirMatchFiles(const char *pattern, Path *p, Lst expansions)
 	 * begins with a dot (note also that as a side effect of the hashing
 	 * scheme, .* won't match . or .. since they aren't hashed).
 	 */
-	if (Str_Match(entry->name, pattern) &&
+	if (Str_PatternMatch(&spat, entry->name) &&
 	    ((entry->name[0] != '.') ||
 	     (pattern[0] == '.')))
 	{
@@ -917,7 +941,7 @@ DirLookupSubdir(Path *p, const char *name)
 	fprintf(debug_file, "checking %s ...\n", file);
     }
 
-    if (stat(file, &stb) == 0) {
+    if (DirStat(file, &stb) == 0) {
 	if (stb.st_mtime == 0)
 		stb.st_mtime = 1;
 	/*
@@ -1312,7 +1336,7 @@ Dir_FindFile(const char *name, Lst path)
 	    fprintf(debug_file, "   got it (in mtime cache)\n");
 	}
 	return(bmake_strdup(name));
-    } else if (stat(name, &stb) == 0) {
+    } else if (DirStat(name, &stb) == 0) {
 	if (stb.st_mtime == 0)
 		stb.st_mtime = 1;
 	entry = Hash_CreateEntry(&mtimes, name, NULL);
@@ -1368,7 +1392,7 @@ Dir_FindHereOrAbove(char *here, char *search_path, char *result, int rlen) {
 
 		/* try and stat(2) it ... */
 		snprintf(try, sizeof(try), "%s/%s", dirbase, search_path);
-		if (stat(try, &st) != -1) {
+		if (DirStat(try, &st) != -1) {
 			/*
 			 * success!  if we found a file, chop off
 			 * the filename so we return a directory.
@@ -1495,7 +1519,7 @@ Dir_MTime(GNode *gn, Boolean recheck)
 	}
 	stb.st_mtime = Hash_GetTimeValue(entry);
     } else {
-	if (stat(fullName, &stb) < 0) {
+	if (DirStat(fullName, &stb) < 0) {
 	    if (gn->type & OP_MEMBER) {
 		if (fullName != gn->path)
 		    free(fullName);
@@ -1551,6 +1575,11 @@ Dir_AddDir(Lst path, const char *name)
     Path	  *p = NULL;  /* pointer to new Path structure */
     DIR     	  *d;	      /* for reading directory */
     struct dirent *dp;	      /* entry in directory */
+    struct stat	  st;	      /* of the directory, for the shared cache */
+    Boolean	  shared;     /* whether the shared cache may hold it */
+    Buffer	  names;      /* what to put in the shared cache */
+    const char	  *cp, *end;
+    size_t	  len;
 
     if (strcmp(name, ".DOTLAST") == 0) {
 	ln = Lst_Find(path, name, DirFindName);
@@ -1575,12 +1604,38 @@ Dir_AddDir(Lst path, const char *name)
 	    fprintf(debug_file, "Caching %s ...", name);
 	}
 
-	if ((d = opendir(name)) != NULL) {
+	/*
+	 * Other makes may have read the directory already. Only absolute
+	 * names mean the same to all of them.
+	 */
+	shared = *name == '/' && ShCache_Active() &&
+	    DirStat(name, &st) == 0 && S_ISDIR(st.st_mode);
+	if (shared &&
+	    (cp = ShCache_Get(SHC_DIR, name, &st, &len)) != NULL) {
+	    p = bmake_malloc(sizeof(Path));
+	    p->name = bmake_strdup(name);
+	    p->hits = 0;
+	    p->refCount = 1;
+	    Hash_InitTable(&p->files, -1);
+
+	    for (end = cp + len; cp < end; cp += strlen(cp) + 1)
+		(void)Hash_CreateEntry(&p->files, cp, NULL);
+	    (void)Lst_AtEnd(openDirectories, p);
+	    if (path != NULL)
+		(void)Lst_AtEnd(path, p);
+	} else if ((d = opendir(name)) != NULL) {
 	    p = bmake_malloc(sizeof(Path));
 	    p->name = bmake_strdup(name);
 	    p->hits = 0;
 	    p->refCount = 1;
 	    Hash_InitTable(&p->files, -1);
+	    /*
+	     * A directory changed within the last second could change
+	     * again without its times changing; do not share that.
+	     */
+	    shared = shared && st.st_mtime < now - 1 && st.st_ctime < now - 1;
+	    if (shared)
+		Buf_Init(&names, 0);
 
 	    while ((dp = readdir(d)) != NULL) {
 #if defined(sun) && defined(d_ino) /* d_ino is a sunos4 #define for d_fileno */
@@ -1594,12 +1649,27 @@ Dir_AddDir(Lst path, const char *name)
 		}
 #endif /* sun && d_ino */
 		(void)Hash_CreateEntry(&p->files, dp->d_name, NULL);
+		if (shared)
+		    Buf_AddBytes(&names, strlen(dp->d_name) + 1,
+				 (Byte *)dp->d_name);
 	    }
 	    (void)closedir(d);
+	    if (shared) {
+		cp = (char *)Buf_GetAll(&names, NULL);
+		ShCache_Put(SHC_DIR, name, &st, ShCache_Generation(),
+		    cp, Buf_Size(&names));
+		Buf_Destroy(&names, TRUE);
+	    }
 	    (void)Lst_AtEnd(openDirectories, p);
 	    if (path != NULL)
 		(void)Lst_AtEnd(path, p);
 	}
+#ifdef ECB2G
+	if (p != NULL)
+	    ecb2gSnapshotDir(name, &p->files);
+	else
+	    ecb2gSnapshotFile(name, NULL);
+#endif
 	if (DEBUG(DIR)) {
 	    fprintf(debug_file, "done\n");
 	}
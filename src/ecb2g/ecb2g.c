@@ -51,9 +51,13 @@
 #define	_GNU_SOURCE
 #include    <sys/types.h>
 #include    <sys/stat.h>
+#include    <sys/wait.h>
+#include    <sys/mman.h>
 #include    <fcntl.h>
+#include    <dirent.h>
 #include    <ctype.h>
 #include    <errno.h>
+#include    <stdint.h>
 #include    <stdio.h>
 #include    <stdarg.h>
 #include    <unistd.h>
@@ -65,16 +69,30 @@
 #include    <libgen.h>
 #include    "make.h"
 #include    "dir.h"
-#include    "meta.h"
+#include    "job.h"
 #include    "ecb2g.h"
 #include    "ecb2gconstants.h"
 #include    "lst.lib/lstInt.h"
 
 static FILE *ecFile = NULL;	/* Where we write expanded gmake content  */
+static int ecInfoFd = -1;	/* ECB2G_OUT keys for the wrapper */
 static char *defaultTarget = NULL;
 static int ecDebug = 0;
 static char *ecIncludeFilename = "emake.inc";
 static char makefileDir[PATH_MAX];
+static int mergeSubmakes = 0;	/* follow OP_MAKE targets at translation time */
+static int mergeCount = 0;
+static char *mergeAlias = NULL;	/* our root target when merged into a parent */
+static char *mergeObjDir = NULL; /* namespace for relative target names */
+static char *ecScope = NULL;	/* prefix variable lines with "scope: " */
+static int ecBol = 1;
+static int skipOODate = 0;	/* leave datedness to emake */
+static int shareRecipes = 0;	/* emit repeated recipes once, as defines */
+static int recipeCount = 0;
+static Hash_Table recipeTab;
+static char *snapDir = NULL;	/* ECB2G_SNAPSHOT */
+static int snapRecord = 0;	/* noting what the translation looks at */
+static Buffer snapInfo;		/* ECB2G_OUT keys to repeat */
 #ifdef ECB2G_SPLIT_SANDBOX
 static char *bmakeObjroot = NULL; 
 static char *splitSbObjroot = NULL;
@@ -90,6 +108,17 @@ ecb2gEnabled(void)
     return (ecFile != NULL);
 }
 
+/*
+ * Return boolean of whether targets are translated without first
+ * checking if they are out-of-date.  emake decides that again anyway,
+ * so this saves a stat(2) of every target and its meta file.
+ */
+int
+ecb2gSkipOODate(void)
+{
+    return skipOODate;
+}
+
 /*
  * Simple varargs style debug utility.
  */
@@ -130,11 +159,45 @@ ecb2gPrintf(char *fmt, ...)
 {
     va_list ap;
     va_start(ap, fmt);
-    vfprintf(ecFile ? ecFile : stderr, fmt, ap);
+    if (ecScope && ecFile) {
+	/* a merged flat file turns its variables into target-specific
+	   ones so they do not leak into the rest of the tree */
+	char *buf, *cp, *nl;
+
+	if (vasprintf(&buf, fmt, ap) >= 0) {
+	    for (cp = buf; *cp; cp = nl) {
+		if (ecBol && *cp != '\n' && *cp != '#')
+		    fprintf(ecFile, "%s: ", ecScope);
+		nl = strchr(cp, '\n');
+		nl = nl ? nl + 1 : cp + strlen(cp);
+		fwrite(cp, 1, nl - cp, ecFile);
+		ecBol = (nl[-1] == '\n');
+	    }
+	    free(buf);
+	}
+    } else
+	vfprintf(ecFile ? ecFile : stderr, fmt, ap);
     fflush(ecFile ? ecFile : stderr);
     va_end(ap);
 }
 
+/*
+ * Write an ECB2G_OUT key to the flat file, and to the wrapper's info
+ * pipe so it does not have to scan the flat file for it.
+ */
+static void
+ecb2gOutKey(const char *key, const char *val)
+{
+    ecb2gPrintf("%s%s\n", key, val);
+    if (ecInfoFd >= 0)
+	dprintf(ecInfoFd, "%s%s\n", key, val);
+    if (snapRecord) {
+	Buf_AddBytes(&snapInfo, strlen(key), (const Byte *)key);
+	Buf_AddBytes(&snapInfo, strlen(val), (const Byte *)val);
+	Buf_AddByte(&snapInfo, '\n');
+    }
+}
+
 /*
  * SIGSEGV handler
  */
@@ -149,6 +212,8 @@ printException(int sig)
 
 static Hash_Table hTab;
 
+static void ecb2gSnapshotInit(const char *);
+
 /*
  * Determine if we are wanted (i.e., ECB2G_FLATFILE var exists), and
  * set up for use.
@@ -185,6 +250,33 @@ ecb2gInit()
 	}
 	unsetenv(ECB2G_ENV_FLATFILE);
 	ecDebug = debugStr ? atoi(debugStr) : 0;
+	if (getenv(ECB2G_ENV_INFO_FD)) {
+	    ecInfoFd = atoi(getenv(ECB2G_ENV_INFO_FD));
+	    if (fcntl(ecInfoFd, F_SETFD, FD_CLOEXEC) < 0)
+		ecInfoFd = -1;
+	    unsetenv(ECB2G_ENV_INFO_FD);
+	}
+	if (getenv(ECB2G_ENV_MERGE)) {
+	    char *alias = getenv(ECB2G_ENV_MERGE_ALIAS);
+
+	    mergeSubmakes = 1;
+	    /* submakes we run must not inherit our flat file */
+	    fcntl(fileno(ecFile), F_SETFD, FD_CLOEXEC);
+	    if (alias) {
+		mergeAlias = strdup(alias);
+		unsetenv(ECB2G_ENV_MERGE_ALIAS);
+	    }
+	}
+	skipOODate = (getenv(ECB2G_ENV_NO_OODATE) != NULL);
+	/* merged flat files would define the same recipe names */
+	if (getenv(ECB2G_ENV_SHARE) && !mergeSubmakes) {
+	    shareRecipes = 1;
+	    Hash_InitTable(&recipeTab, 256);
+	}
+	/* a merged flat file also depends on every submake's inputs */
+	snapDir = getenv(ECB2G_ENV_SNAPSHOT);
+	if (snapDir && *snapDir && !mergeSubmakes && !mergeAlias)
+	    ecb2gSnapshotInit(flatfile);
 	if (ecb2gmakeCwd) {
 	    ecb2gPrintf(FLATFILE_CWD_KEY"%s\n", ecb2gmakeCwd);
 	}
@@ -265,6 +357,40 @@ printEnvValue(char *name, char *value)
 #endif
 }
 
+/*
+ * Scratch space for the preamble, reused for every variable
+ */
+static Buffer ecScratch;
+
+/*
+ * Return str with each $ doubled for gmake(1), in ecScratch.
+ */
+static char *
+ecb2gEscape(const char *str)
+{
+    const char *cp;
+
+    Buf_Empty(&ecScratch);
+    for (cp = str; *cp; cp++) {
+	if (*cp == '$')
+	    Buf_AddByte(&ecScratch, '$');
+	Buf_AddByte(&ecScratch, *cp);
+    }
+    return (char *)Buf_GetAll(&ecScratch, NULL);
+}
+
+/*
+ * Var_Subst, skipped when there is nothing left to expand.
+ * The result is always to be freed.
+ */
+static char *
+ecb2gSubst(const char *str, GNode *ctxt, Boolean undefErr)
+{
+    if (!strchr(str, '$'))
+	return bmake_strdup(str);
+    return Var_Subst(NULL, str, ctxt, undefErr);
+}
+
 /*
  * Generate an 'export VAR=value' string, where value is fully
  * expanded.
@@ -272,51 +398,263 @@ printEnvValue(char *name, char *value)
 static void
 envExport(char *name, char *vali)
 {
-    char *buf2, *val;
-    int new;
+    char *val;
 
-    val = Var_Subst(NULL, vali, VAR_GLOBAL, 0);
+    val = ecb2gSubst(vali, VAR_GLOBAL, 0);
     if (!val)
 	return;
     if (strchr(val, '$')) {
-	int i, j;
-	int len = strlen(val);
-	char *buf = malloc(len * 2);
 	/* we also have to re-escape the $ */
-	for(i = 0, j = 0; i < len && j < ((len * 2) - 2); i++, j++) {
-	    if (val[i] == '$') buf[j++] = '$';
-	    buf[j] = val[i];
-	}
-	buf[j] = '\0';
 	ecb2gPrintf("export "BMAKETAG"%s=", name);
-	printEnvValue(name, buf);
+	printEnvValue(name, ecb2gEscape(val));
 	ecb2gPrintf("\n");
-	free(buf);
     }
     /* simple fully resolved value of the variable for compsumption by gmake(1) */
     ecb2gPrintf("export %s=", name);
     printEnvValue(name, val);
     ecb2gPrintf("\n");
+    free(val);
 }
 
 /*
- * Generate a comment that contains values for a global var
+ * What the preamble emits for each variable, in order.
+ */
+typedef enum {
+    EC_COMMENT,		/* '# ECB2GDEBUG VAR' line, raw value */
+    EC_PROG,		/* program and its flags, for implicit rules */
+    EC_IMPLICIT,	/* expanded, for implicit rules */
+    EC_EXPORT,		/* 'export as=' raw global value */
+    EC_RAW,		/* 'as=' raw global value */
+    EC_DEPEND,		/* expanded global value, for dependency update */
+    EC_DEPEND_ESC	/* the same with $ re-escaped */
+} EcHow;
+
+static const struct {
+    const char *name;
+    const char *as;	/* flat file name, or flags var for EC_PROG */
+    EcHow how;
+} ecPreambleVars[] = {
+    { "__objdir", NULL, EC_COMMENT },
+    { "__path", NULL, EC_COMMENT },
+    { ".OBJDIR", NULL, EC_COMMENT },
+    { ".PATH", NULL, EC_COMMENT },
+    { "MAKEOBJDIRPREFIX", NULL, EC_COMMENT },
+    { "MAKEOBJDIR", NULL, EC_COMMENT },
+    { ".CURDIR", NULL, EC_COMMENT },
+    { ".PARSEDIR", NULL, EC_COMMENT },
+    { "OBJS", NULL, EC_COMMENT },
+    { "SRCS", NULL, EC_COMMENT },
+    { "CFLAGS", NULL, EC_COMMENT },
+    { "CC", NULL, EC_COMMENT },
+    { "_CC", NULL, EC_COMMENT },
+    { "ISSU_OBJDIR", NULL, EC_COMMENT },
+    { "JKERNEL_OBJDIR", NULL, EC_COMMENT },
+    { "SHARED_ROOTDIR", NULL, EC_COMMENT },
+    { ".MAKE.EXPORTED", NULL, EC_COMMENT },
+    /* if implicit rules are used, we need to make the implicit rules'
+       variables available */
+    { "AR", "ARFLAGS", EC_PROG },
+    { "AS", "ASFLAGS", EC_PROG },
+    { "CC", "CFLAGS", EC_PROG },
+    { "CXX", "CXXFLAGS", EC_PROG },
+    { "CPP", "CPPFLAGS", EC_PROG },
+    { "FC", NULL, EC_IMPLICIT },
+    { "M2C", NULL, EC_IMPLICIT },
+    { "PC", NULL, EC_IMPLICIT },
+    { "CO", NULL, EC_IMPLICIT },
+    { "GET", NULL, EC_IMPLICIT },
+    { "LEX", NULL, EC_IMPLICIT },
+    { "YACC", NULL, EC_IMPLICIT },
+    { "LINT", NULL, EC_IMPLICIT },
+    { "MAKEINFO", NULL, EC_IMPLICIT },
+    { "TEX", NULL, EC_IMPLICIT },
+    { "TEXI2DVI", NULL, EC_IMPLICIT },
+    { "WEAVE", NULL, EC_IMPLICIT },
+    { "CWEAVE", NULL, EC_IMPLICIT },
+    { "TANGLE", NULL, EC_IMPLICIT },
+    { "CTANGLE", NULL, EC_IMPLICIT },
+    { "RM", NULL, EC_IMPLICIT },
+    { "COFLAGS", NULL, EC_IMPLICIT },
+    { "FFLAGS", NULL, EC_IMPLICIT },
+    { "GFLAGS", NULL, EC_IMPLICIT },
+    { "LDFLAGS", NULL, EC_IMPLICIT },
+    { "LDLIBS", NULL, EC_IMPLICIT },
+    { "LFLAGS", NULL, EC_IMPLICIT },
+    { "YFLAGS", NULL, EC_IMPLICIT },
+    { "PFLAGS", NULL, EC_IMPLICIT },
+    { "RFLAGS", NULL, EC_IMPLICIT },
+    { "LINTFLAGS", NULL, EC_IMPLICIT },
+    { "MAKEFLAGS", "MAKEFLAGS", EC_EXPORT },
+    { "SHELL", "SHELL", EC_RAW },
+    /* unexported make variables that need to be exposed for
+     * dependency update */
+    { "DPADD", NULL, EC_DEPEND },
+    { "FORCE_DPADD", NULL, EC_DEPEND },
+    { "MACHINE_ARCH", NULL, EC_DEPEND },
+    { "META_FILE_FILTER", NULL, EC_DEPEND },
+    { "META_XTRAS", NULL, EC_DEPEND },
+    { "OBJS", NULL, EC_DEPEND },
+    { "SUPPRESS_DEPEND", NULL, EC_DEPEND },
+    { "UPDATE_DEPENDFILE", NULL, EC_DEPEND },
+    { "GENDIRDEPS_DIR_LIST_XTRAS", NULL, EC_DEPEND_ESC },
+    { "GENDIRDEPS_FILTER", NULL, EC_DEPEND_ESC },
+    /* dependency update variables with dots in their
+       names which need to be removed for gmake. */
+    { ".MAKE.DEPENDFILE", "MAKE_DEPENDFILE", EC_RAW },
+    { ".MAKE.MAKEFILE_PREFERENCE", "MAKE_MAKEFILE_PREFERENCE", EC_RAW },
+    { NULL, NULL, 0 }
+};
+
+/*
+ * bmake includes parameters in the CC, CXX program. Gmake expects an
+ * executable path.  So we transfer the parameters from the program to
+ * the start of the corresponding FLAGS variable.
+ */
+static void
+ecb2gProgFlags(const char *pname, const char *fname, GNode *gn)
+{
+    char *prog, *flags, *exp, *moreflags = "";
+    char *p1 = NULL, *p2 = NULL;
+
+    prog = Var_Value(pname, gn, &p1);
+    flags = Var_Value(fname, gn, &p2);
+    if (!flags) flags = "";
+
+    exp = NULL;
+    if (prog) {
+	prog = exp = ecb2gSubst(prog, gn, FALSE);
+	/* stump it */
+	while (*prog) if (*prog != ' ' && *prog != '\t') break; else prog++;
+	moreflags = prog;
+	while (*moreflags) if (*moreflags == ' ' || *moreflags++ == '\t') break;
+	if (*moreflags) *moreflags++ = '\0';
+	prog = ecb2gSubst(prog, gn, FALSE);
+	ecb2gPrintf("%s=%s\n", pname, prog);
+	free(prog);
+    }
+    flags = ecb2gSubst(flags, gn, FALSE);
+    Buf_Empty(&ecScratch);
+    Buf_AddBytes(&ecScratch, strlen(moreflags), moreflags);
+    Buf_AddByte(&ecScratch, ' ');
+    Buf_AddBytes(&ecScratch, strlen(flags), flags);
+    free(flags);
+    flags = ecb2gSubst((char *)Buf_GetAll(&ecScratch, NULL), gn, FALSE);
+    ecb2gPrintf("%s=%s\n", fname, flags);
+    free(flags);
+    free(exp);
+    free(p1);
+    free(p2);
+}
+
+/*
+ * Emit the variables and exports that follow the default target
+ * in the flat file.
  */
 static void
-varComment(char *varName, GNode   *gn)
+ecb2gPreamble(GNode *gn)
 {
-    char *val = NULL, *p;
-    while (1) {
-	if (gn) {
-	    val = Var_Value(varName, gn, &p);
-	    if (val) break;
+    Hash_Search cursor;
+    Hash_Entry *e;
+    char *p = NULL, *val, *exp;
+    int i;
+
+    Buf_Init(&ecScratch, 0);
+
+    val = Var_Value(".MAKE.EXPORTED", gn, &p);
+    if (val) {
+	char *copy = bmake_strdup(val);
+	char *tok = strtok(copy, " \t");
+
+	while (tok) {
+	    int new;
+	    e = Hash_CreateEntry(&hTab, tok, &new);
+	    if (new) {
+		char *p2 = NULL;
+		char *v = Var_Value(e->name, VAR_GLOBAL, &p2);
+		Hash_SetValue(e, v ? bmake_strdup(v) : NULL);
+		free(p2);
+	    }
+	    tok = strtok(NULL, " \t");
+	}
+	free(copy);
+    }
+    free(p);
+
+    for (e = Hash_EnumFirst(&hTab, &cursor); e; e = Hash_EnumNext(&cursor)) {
+	if (Hash_GetValue(e))
+	    envExport(e->name, Hash_GetValue(e));
+    }
+
+    /* also export the MAKEOVERRIDES at this time */
+    p = NULL;
+    val = Var_Value(".MAKEOVERRIDES", VAR_GLOBAL, &p);
+    if (val) {
+	char *copy = bmake_strdup(val);
+	char *exname = strtok(copy, " ");
+
+	while (exname) {
+	    char *p2 = NULL;
+	    char *val2 = Var_Value(exname, VAR_GLOBAL, &p2);
+	    ecb2gPrintf("export %s=%s\n", exname, val2);
+	    free(p2);
+	    exname = strtok(NULL, " ");
 	}
-	val = Var_Value(varName, VAR_GLOBAL, &p);
-	break;
+	free(copy);
     }
-    ecb2gPrintf("# ECB2GDEBUG VAR %s '%s'\n", varName, val);
-    if (p)
+    free(p);
+    p = NULL;
+    val = Var_Value(".CURDIR", VAR_GLOBAL, &p);
+    ecb2gPrintf("export BMAKELOCATION=%s\n", val ? val : "unknown");
+    free(p);
+
+    for (i = 0; ecPreambleVars[i].name; i++) {
+	const char *name = ecPreambleVars[i].name;
+	const char *as = ecPreambleVars[i].as;
+
+	p = NULL;
+	switch (ecPreambleVars[i].how) {
+	case EC_COMMENT:
+	case EC_IMPLICIT:
+	    val = Var_Value(name, gn, &p);
+	    if (!val) {
+		free(p);
+		p = NULL;
+		val = Var_Value(name, VAR_GLOBAL, &p);
+	    }
+	    if (ecPreambleVars[i].how == EC_COMMENT) {
+		ecb2gPrintf("# ECB2GDEBUG VAR %s '%s'\n", name, val);
+	    } else if (val) {
+		exp = ecb2gSubst(val, gn, FALSE);
+		ecb2gPrintf("%s=%s\n", name, exp);
+		free(exp);
+	    }
+	    break;
+	case EC_PROG:
+	    ecb2gProgFlags(name, as, gn);
+	    break;
+	case EC_EXPORT:
+	case EC_RAW:
+	    val = Var_Value(name, VAR_GLOBAL, &p);
+	    if (val)
+		ecb2gPrintf("%s%s=%s\n",
+			    ecPreambleVars[i].how == EC_EXPORT ? "export " : "",
+			    as, val);
+	    break;
+	case EC_DEPEND:
+	case EC_DEPEND_ESC:
+	    val = Var_Value(name, VAR_GLOBAL, &p);
+	    if (val) {
+		exp = ecb2gSubst(val, VAR_GLOBAL, TRUE);
+		ecb2gPrintf("%s=%s\n", name,
+			    ecPreambleVars[i].how == EC_DEPEND_ESC ?
+			    ecb2gEscape(exp) : exp);
+		free(exp);
+	    }
+	    break;
+	}
 	free(p);
+    }
+    Buf_Destroy(&ecScratch, TRUE);
 }
 
 /*
@@ -331,7 +669,7 @@ ecb2gSetMakefile(char *makefile)
     m = strdup(makefile);
     strcpy(makefileDir, dirname(m));
     free(m);
-    ecb2gPrintf(FLATFILE_MAKEFILE_KEY"%s\n", makefile);
+    ecb2gOutKey(FLATFILE_MAKEFILE_KEY, makefile);
 }
 
 /*
@@ -353,7 +691,24 @@ ecb2gSetObjDir(char *objdir)
 	fprintf(stderr, "ecb2g: Failed to find the realpath for %s\n", objdir);
 	exit(1);
     }
-    ecb2gPrintf(FLATFILE_OBJDIR_KEY"%s\n", objpath);
+    ecb2gOutKey(FLATFILE_OBJDIR_KEY, objpath);
+    if (mergeAlias)
+	mergeObjDir = strdup(objpath);
+}
+
+/*
+ * When merged into a parent flat file, relative target names are
+ * made absolute under our objdir so that each subtree gets its own
+ * namespace.  Returns name or a string to be freed via *freeIt.
+ */
+static char *
+ecb2gNamespace(char *name, char **freeIt)
+{
+    *freeIt = NULL;
+    if (!mergeObjDir || *name == '/' || !strcmp(name, ".PHONY"))
+	return name;
+    *freeIt = str_concat(mergeObjDir, name, STR_ADDSLASH);
+    return *freeIt;
 }
 
 /*
@@ -364,13 +719,6 @@ void
 ecb2gDefault(Lst targs, Lst vpaths)
 {
     if (ecFile) {
-	static char const *impVars[] = {
-	    "AR.ARFLAGS","AS.ASFLAGS","CC.CFLAGS","CXX.CXXFLAGS","CPP.CPPFLAGS","FC","M2C","PC","CO",
-	    "GET","LEX","YACC","LINT","MAKEINFO","TEX","TEXI2DVI",
-	    "WEAVE","CWEAVE","TANGLE","CTANGLE","RM",
-	    "COFLAGS","FFLAGS","GFLAGS","LDFLAGS","LDLIBS","LFLAGS",
-	    "YFLAGS","PFLAGS","RFLAGS","LINTFLAGS", NULL,
-	};
 	if (!Lst_IsEmpty(targs)) {
 	    ListNode tln;
 	    GNode *gn;
@@ -395,7 +743,7 @@ ecb2gDefault(Lst targs, Lst vpaths)
 		    }
 		}
 	    }
-	    ecb2gPrintf(FLATFILE_SECONDARY_OBJDIR_KEY"%s\n", \
+	    ecb2gOutKey(FLATFILE_SECONDARY_OBJDIR_KEY,
 			(objval ? objval : FLATFILE_NOT_DEFINED_KEY));
 	    if (pobj)
 		free(pobj);
@@ -404,221 +752,35 @@ ecb2gDefault(Lst targs, Lst vpaths)
 	    /* Include emake.inc if present in the source direcory. */
 	    ecb2gPrintf("-include %s/%s\n\n", makefileDir, ecIncludeFilename);
 
-	    ecb2gPrintf("\n.INTERMEDIATE: .BEGIN .END\n.BEGIN:\n.END:\n");
-	    defaultTarget = strdup(gn->path ? gn->path : gn->name);
-	    ecb2gPrintf("\n%s:\n\n", defaultTarget);
-
 	    {
-		char *p = NULL;
-		char *val = Var_Value(".MAKE.EXPORTED", gn, &p);
-
-		if (val) {
-		    char *tok = strtok(strdup(val), " \t");
-		    while (tok) {
-			int new;
-			Hash_Entry *e = Hash_CreateEntry(&hTab, tok, &new);
-			if (new) {
-			    char *p = NULL;
-			    Hash_SetValue(e, Var_Value(e->name, VAR_GLOBAL, &p));
-			    if (p)
-				free(p);
-			}
-			tok = strtok(NULL, " \t");
-		    }
-		}
-		if (p)
-		    free(p);
-	    }
-
-	    {
-		Hash_Search cursor;
-		Hash_Entry *e = Hash_EnumFirst(&hTab, &cursor);
-		while (e) {
-		    char *val;
-		    envExport(e->name, Hash_GetValue(e));
-		    e = Hash_EnumNext(&cursor);
+		char *fb, *fe, *fd;
+		char *b = ecb2gNamespace(".BEGIN", &fb);
+		char *e = ecb2gNamespace(".END", &fe);
+		char *d;
+
+		ecb2gPrintf("\n.INTERMEDIATE: %s %s\n%s:\n%s:\n", b, e, b, e);
+		defaultTarget = strdup(gn->path ? gn->path : gn->name);
+		d = ecb2gNamespace(defaultTarget, &fd);
+		ecb2gPrintf("\n%s:\n\n", d);
+		if (mergeAlias) {
+		    ecb2gPrintf(".PHONY: %s\n%s: %s\n\n", mergeAlias, mergeAlias, d);
+		    ecScope = mergeAlias;
+		    ecBol = 1;
 		}
+		free(fb);
+		free(fe);
+		free(fd);
 	    }
 
-	    /* also export the MAKEOVERRIDES at this time */
-	    {
-		char *p = NULL;
-		char *val = Var_Value(".MAKEOVERRIDES", VAR_GLOBAL, &p);
-
-		if (val) {
-		    char *p2 = NULL;
-		    char *exname = strtok(val, " ");
-
-		    while (exname) {
-			char *val2 = Var_Value(exname, VAR_GLOBAL, &p2);
-			ecb2gPrintf("export %s=%s\n", exname, val2);
-			if (p2) 
-			    free(p2);
-			exname = strtok(NULL, " ");
-		    }
-		}
-		if (p) 
-		    free(p);
-		val = Var_Value(".CURDIR", VAR_GLOBAL, &p);
-		if (val) {
-		    ecb2gPrintf("export BMAKELOCATION=%s\n", val);
-		} else {
-		    ecb2gPrintf("export BMAKELOCATION=unknown\n");
-		}
-		if (p) 
-		    free(p);
-
-		varComment("__objdir", gn);
-		varComment("__path", gn);
-		varComment(".OBJDIR", gn);
-		varComment(".PATH", gn);
-		varComment("MAKEOBJDIRPREFIX", gn);
-		varComment("MAKEOBJDIR", gn);
-		varComment(".CURDIR", gn);
-		varComment(".PARSEDIR", gn);
-		varComment("OBJS", gn);
-		varComment("SRCS", gn);
-		varComment("CFLAGS", gn);
-		varComment("CC", gn);
-		varComment("_CC", gn);
-		varComment("ISSU_OBJDIR", gn);
-		varComment("JKERNEL_OBJDIR", gn);
-		varComment("SHARED_ROOTDIR", gn);
-		varComment(".MAKE.EXPORTED", gn);
-
-		/* if implicit rules are used, we need to make the implicit rules'
-		   variables available */
-		{
-		    int idx = 0;
-		    while (impVars[idx]) {
-			/* bmake includes parameters in the CC, CXX program. Gmake expects an executable path.
-			   So impVar associates such program vars with their correspoinding FLAGS var and we
-			   transfer the variables from the program to the start of the FLAGS */
-			char *dot = strchr(impVars[idx], '.');
-			if (dot) {
-			    char *prog, *flags, *pname;
-			    char *moreflags = "";
-			    char *p1 = NULL;
-			    char *p2 = NULL;
-
-			    pname = strndup(impVars[idx], dot - impVars[idx]);
-			    prog = Var_Value(pname, gn, &p1);
-			    flags = Var_Value(dot + 1, gn, &p2);
-			    if (!flags) flags="";
-
-			    if (prog) {
-				prog = Var_Subst(NULL, prog, gn, FALSE);
-				/* stump it */
-				while (*prog) if (*prog != ' ' && *prog != '\t') break; else prog++;
-				moreflags = prog;
-				while (*moreflags) if (*moreflags == ' ' || *moreflags++ == '\t') break;
-				if (*moreflags) *moreflags++ = '\0';
-				ecb2gPrintf("%s=%s\n", pname, Var_Subst(NULL, prog, gn, FALSE));
-			    }
-			    if (flags) {
-				char *allflags;
-				flags = Var_Subst(NULL, flags, gn, FALSE);
-				allflags = malloc(strlen(flags) + strlen(moreflags) + 2);
-				sprintf(allflags, "%s %s", moreflags, flags);
-				ecb2gPrintf("%s=%s\n", dot + 1, Var_Subst(NULL, allflags, gn, FALSE));
-			    }
-			    if (p1)
-				free(p1);
-			    if (p2)
-				free(p2);
-			} else {
-			    val = Var_Value(impVars[idx], gn, &p);
-			    if (!val) val = Var_Value(impVars[idx], VAR_GLOBAL, &p);
-			    if (val) {
-				ecb2gPrintf("%s=%s\n", impVars[idx], Var_Subst(NULL, val, gn, FALSE));
-			    }
-			    if (p)
-				free(p);
-			}
-			idx++;
-		    }
-		}
+	    Prof_Phase("preamble");
+	    ecb2gPreamble(gn);
+	    Prof_Phase("emit");
 
-		val = Var_Value("MAKEFLAGS", VAR_GLOBAL, &p);
-		if (val) {
-		    ecb2gPrintf("export MAKEFLAGS=%s\n", val);
-		    free(p);
-		}
-		val = Var_Value("SHELL", VAR_GLOBAL, &p);
-		if (val) {
-		    ecb2gPrintf("SHELL=%s\n", val);
-		    free(p);
-		}
-		{
-		    /* unexported make variables that need to be exposed for
-		     * dependency update */
-		    static const char *depVars[] = {
-			"DPADD", "FORCE_DPADD", 
-			"MACHINE_ARCH", "META_FILE_FILTER",
-			"META_XTRAS", "OBJS",
-			"SUPPRESS_DEPEND", "UPDATE_DEPENDFILE", NULL
-		    };
-		    /* unexported make variables that need to be exposed for
-		     * dependency update and need to have dollar signs
-		     * escaped */
-		    static const char *depdollarVars[] = {
-			"GENDIRDEPS_DIR_LIST_XTRAS", 
-			"GENDIRDEPS_FILTER", NULL
-		    };
-		    int idx = 0;
-		    char *val2;
-
-		    while (depVars[idx]) {
-			val = Var_Value(depVars[idx], VAR_GLOBAL, &p);
-			if(val) {
-			    val2 = Var_Subst(NULL, val, VAR_GLOBAL, TRUE);
-			    ecb2gPrintf("%s=%s\n", depVars[idx], val2);
-			}
-			if (p)
-			    free(p);
-			idx++;
-		    }
-		    idx = 0;
-		    while (depdollarVars[idx]) {
-			val = Var_Value(depdollarVars[idx], VAR_GLOBAL, &p);
-			if(val) {
-			    val2 = Var_Subst(NULL, val, VAR_GLOBAL, TRUE);
-			    if (strchr(val2, '$')) {
-				int i, j;
-				int len = strlen(val2);
-				char *buf = malloc(len*2);
-
-				for (i=0, j=0; i<len && j<((len*2)-2); i++, j++) {
-				    if (val2[i] == '$') buf[j++] = '$';
-				    buf[j] = val2[i];
-				}
-				buf[j] = '\0';
-				ecb2gPrintf("%s=%s\n", depdollarVars[idx], buf);
-				free(buf);
-			    } else {
-				ecb2gPrintf("%s=%s\n", depdollarVars[idx], val2);
-			    }
-			}
-			if (p)
-			    free(p);
-			idx++;
-		    }
-		};
-		/* dependency update variables with dots in their
-		   names which need to be removed for gmake. */
-		val = Var_Value(".MAKE.DEPENDFILE", VAR_GLOBAL, &p);
-		if(val) {
-		    ecb2gPrintf("MAKE_DEPENDFILE=%s\n", val);
-		    free(p);
-		}
-		val = Var_Value(".MAKE.MAKEFILE_PREFERENCE", VAR_GLOBAL, &p);
-		if(val) {
-		    ecb2gPrintf("MAKE_MAKEFILE_PREFERENCE=%s\n", val);
-		    free(p);
-		}
-		/* define and export a newline variable */
+	    /* define and export a newline variable; a merged
+	       flat file gets it from the parent */
+	    ecScope = NULL;
+	    if (!mergeAlias)
 		ecb2gPrintf("define newline\n\n\nendef\nexport newline\n");
-	    }
 	}
     }
 }
@@ -644,6 +806,62 @@ ecb2gMapTargetName(char *name)
     return name;
 }
 
+/*
+ * Write an expanded command to the flat file.  Since the command
+ * would have been fed to a shell and not to, yet another, makefile,
+ * we need to re-escape the $.  We also replace line feed characters
+ * within the command with '"$${newline}"' so that emake will be able
+ * to parse the commands and not be tripped up by newline characters.
+ * Runs of plain text are copied straight to the output stream.
+ * With autoVars, the ECB2G_AUTO_MARK markers left by ecb2gShareRecipe
+ * become gmake's $@, $< and $^.
+ */
+static void
+ecb2gPutCommand(FILE *fp, const char *cp, int autoVars)
+{
+    const char *run;
+
+    for (run = cp; *cp; cp++) {
+	if (*cp == '$') {
+	    /* write up to and including the $, and start the
+	       next run on it again */
+	    fwrite(run, 1, cp - run + 1, fp);
+	    run = cp;
+	} else if (*cp == '\n' && cp[1]) {
+	    fwrite(run, 1, cp - run, fp);
+	    fputs("\'\"$${newline}\"\'", fp);
+	    run = cp + 1;
+	} else if (autoVars && *cp == ECB2G_AUTO_MARK &&
+		   (cp[1] == '@' || cp[1] == '<' || cp[1] == '^')) {
+	    fwrite(run, 1, cp - run, fp);
+	    putc('$', fp);
+	    run = ++cp;
+	}
+    }
+    fwrite(run, 1, cp - run, fp);
+}
+
+/*
+ * Write one expanded recipe line, without its leading tab.
+ */
+static void
+ecb2gPutRecipeLine(FILE *fp, GNode *gn, const char *cmd, int autoVars)
+{
+    const char *cp;
+
+    for (cp = cmd; *cp == '@' || *cp == '-' || *cp == '+'; cp++)
+	putc(*cp, fp);
+
+    /* merged recipes no longer run from our objdir */
+    if (mergeObjDir) fprintf(fp, "cd %s || exit 1; ", mergeObjDir);
+
+    /* we include file:line info if debug is above 4 */
+    if (gn->fname) fprintf(fp, "export BMAKELOCATION=%s:%d; ", gn->fname, gn->lineno);
+
+    ecb2gPutCommand(fp, cp, autoVars);
+    putc('\n', fp);
+}
+
 /*
  * This callback will be called once for each of the commands associated
  * with a target.
@@ -655,64 +873,148 @@ ecb2gTargetCommands(void *cmdp, void *gnp)
 
     GNode *gn = (GNode *)gnp;
     char *cmd = (char *)cmdp;
-    int len, blen, i, j, dollars, newlines, first = 0;
-    char *xtra, *buf;
 
     /* expand it */
     cmd = Var_Subst(NULL, cmd, gn, FALSE);
-    len = strlen(cmd);
 
     /* all command start with a tab at the beginning of the line */
     ecb2gPrintf("\t");
+    ecb2gPutRecipeLine(ecFile, gn, cmd, 0);
+    fflush(ecFile);
+    free(cmd);
+    return 0;
+}
 
-    /* since the final expanded commands would have been fed to a bash and not
-       to, yet another, makefile, we need to re-escape the $.
-       We also replace line feed characters within the command to
-       '"$${newline}"' so that emake will be able to parse the commands
-       and not be tripped up by newline characters */
-    for (i = 0, dollars = 0; i < len; i++) if (cmd[i] == '$') dollars++;
-    for (i = 0, newlines = 0; i < len-1; i++) if (cmd[i] == '\n') newlines++;
-    /* strlen of '"$${newline}"' is 15, but we are replacing a character, so
-       only need to add 14 chars for each substitution. */
-    blen = len + dollars + 14*newlines;
-    buf = malloc(blen + 1);
-    buf[blen] = '\0';
-    for (i = 0, j = 0; i < len; i++) {
-	buf[j++] = cmd[i];
-	if (cmd[i] == '$') buf[j++] = cmd[i];
-	else if ((i<len-1) && (cmd[i] == '\n')) {
-	    strcpy(buf+j-1,"\'\"$${newline}\"\'");
-	    /* only need to add 14, not 15 because we already did j++ above */
-	    j = j+ 14;
-	}
+/*
+ * Check that expanding a command with the automatic variable markers
+ * gave the same text as the plain expansion once the markers are put
+ * back, i.e. that the command only used .TARGET, .IMPSRC and .ALLSRC
+ * as is.
+ */
+static Boolean
+ecb2gSameExpansion(const char *marked, const char *plain,
+		   const char *target, const char *impsrc, const char *allsrc)
+{
+    const char *val;
+    size_t len;
+
+    while (*marked) {
+	if (*marked == ECB2G_AUTO_MARK &&
+	    (marked[1] == '@' || marked[1] == '<' || marked[1] == '^')) {
+	    val = marked[1] == '@' ? target :
+		marked[1] == '<' ? impsrc : allsrc;
+	    len = strlen(val);
+	    if (strncmp(plain, val, len))
+		return FALSE;
+	    plain += len;
+	    marked += 2;
+	} else if (*marked++ != *plain++)
+	    return FALSE;
     }
-    /* bmake(1) does not require continuation characters for
-       multiple line commands, so we need to add them. */
-    while (first < len) {
-	if (buf[first] == '@') {
-	    first++;
-	    ecb2gPrintf("@");
-	} else if (buf[first] == '-') {
-	    first++;
-	    ecb2gPrintf("-");
-	} else if (buf[first] == '+') {
-	    first++;
-	    ecb2gPrintf("+");
+    return *plain == '\0';
+}
+
+/*
+ * With ECB2G_SHARE_RECIPES, expand the commands of gn once more with
+ * .TARGET, .IMPSRC and .ALLSRC standing for gmake's $@, $< and $^, so
+ * that the recipes of targets built the same way come out as the same
+ * text.  first and all are the first and all the prerequisites written
+ * for gn.
+ * Each distinct recipe is written once as a define, ahead of the
+ * first target that uses it.  Returns the number of the define, or 0
+ * if the commands of gn have to be written out as they are.
+ */
+static int
+ecb2gShareRecipe(GNode *gn, char *name, char *first, char *all)
+{
+    static char markTarget[] = { ECB2G_AUTO_MARK, '@', '\0' };
+    static char markImpsrc[] = { ECB2G_AUTO_MARK, '<', '\0' };
+    static char markAllsrc[] = { ECB2G_AUTO_MARK, '^', '\0' };
+    LstNode ln;
+    Hash_Entry *he;
+    FILE *fp;
+    char *target, *impsrc, *allsrc, *p1 = NULL, *p2 = NULL, *p3 = NULL;
+    char *body = NULL, *cmd, *plain, *marked, *cp;
+    size_t blen;
+    Boolean useTarget, useImpsrc, useAllsrc, ok = TRUE;
+    int new;
+
+    if (!shareRecipes || Lst_IsEmpty(gn->commands))
+	return 0;
+
+    target = Var_Value(TARGET, gn, &p1);
+    impsrc = Var_Value(IMPSRC, gn, &p2);
+    allsrc = Var_Value(ALLSRC, gn, &p3);
+    target = target ? bmake_strdup(target) : NULL;
+    impsrc = impsrc ? bmake_strdup(impsrc) : NULL;
+    allsrc = allsrc ? bmake_strdup(allsrc) : NULL;
+    free(p1);
+    free(p2);
+    free(p3);
+    /* the markers only stand in for what gmake will actually use */
+    useTarget = target && !strcmp(target, name);
+    useImpsrc = impsrc && first && !strcmp(impsrc, first);
+    useAllsrc = allsrc && *allsrc && all && !strcmp(allsrc, all);
+
+    fp = open_memstream(&body, &blen);
+    if (!fp)
+	ok = FALSE;
+    for (ln = Lst_First(gn->commands); ok && ln; ln = Lst_Succ(ln)) {
+	cmd = (char *)Lst_Datum(ln);
+	/* expanding twice must not repeat side effects */
+	if (strstr(cmd, ":sh") || strstr(cmd, "::") || strstr(cmd, ":_") ||
+	    strstr(cmd, ":!")) {
+	    ok = FALSE;
+	    break;
 	}
-	else break;
+	plain = Var_Subst(NULL, cmd, gn, FALSE);
+	if (useTarget)
+	    Var_Set(TARGET, markTarget, gn, 0);
+	if (useImpsrc)
+	    Var_Set(IMPSRC, markImpsrc, gn, 0);
+	if (useAllsrc)
+	    Var_Set(ALLSRC, markAllsrc, gn, 0);
+	marked = Var_Subst(NULL, cmd, gn, FALSE);
+	if (useTarget)
+	    Var_Set(TARGET, target, gn, 0);
+	if (useImpsrc)
+	    Var_Set(IMPSRC, impsrc, gn, 0);
+	if (useAllsrc)
+	    Var_Set(ALLSRC, allsrc, gn, 0);
+
+	ok = ecb2gSameExpansion(marked, plain, target ? target : "",
+				impsrc ? impsrc : "", allsrc ? allsrc : "");
+	if (ok)
+	    ecb2gPutRecipeLine(fp, gn, marked, 1);
+	free(plain);
+	free(marked);
+    }
+    if (fp)
+	fclose(fp);
+    free(target);
+    free(impsrc);
+    free(allsrc);
+
+    /* a recipe line must not end the define early */
+    for (cp = body; ok && cp && *cp; cp = strchr(cp, '\n') + 1) {
+	while (*cp == ' ' || *cp == '\t')
+	    cp++;
+	if (!strncmp(cp, "endef", 5) || !strncmp(cp, "define", 6))
+	    ok = FALSE;
+    }
+    if (!ok) {
+	free(body);
+	return 0;
     }
-    /* we include file:line info if debug is above 4 */
-    if (gn->fname) ecb2gPrintf("export BMAKELOCATION=%s:%d; ", gn->fname, gn->lineno);
 
-    for (i = first; i < blen; /* no expr */) {
-	j = i + strlen(buf + i);
-	xtra =  (j < blen) ? "\\n" : "";
-	ecb2gPrintf("%s%s", buf + i, xtra);
-	i += strlen(buf + i) + 1;
+    he = Hash_CreateEntry(&recipeTab, body, &new);
+    if (new) {
+	Hash_SetValue(he, (void *)(intptr_t)++recipeCount);
+	ecb2gPrintf("\ndefine "ECB2G_RECIPE_VAR"%d\n%sendef\n",
+		    recipeCount, body);
     }
-    ecb2gPrintf("\n");
-    free(buf);
-    return 0;
+    free(body);
+    return (int)(intptr_t)Hash_GetValue(he);
 }
 
 /*
@@ -723,10 +1025,143 @@ static int
 ecb2gDependencies(void *cnp, void *gnp)
 {
     GNode *cn = (GNode *)cnp;
-    ecb2gPrintf("%s ", cn->path ? cn->path : ecb2gMapTargetName(cn->name));
+    char *fp;
+    ecb2gPrintf("%s ", ecb2gNamespace(cn->path ? cn->path : ecb2gMapTargetName(cn->name), &fp));
+    free(fp);
     return 0;
 }
 
+/*
+ * The prerequisites of gn as gmake's $^ gives them: in order, each
+ * once.
+ */
+static char *
+ecb2gAllPrereqs(GNode *gn)
+{
+    Hash_Table seen;
+    Buffer buf;
+    LstNode ln;
+    GNode *cn;
+    char *fp, *cp;
+    int new;
+
+    Hash_InitTable(&seen, 0);
+    Buf_Init(&buf, 0);
+    for (ln = Lst_First(gn->children); ln; ln = Lst_Succ(ln)) {
+	cn = (GNode *)Lst_Datum(ln);
+	cp = ecb2gNamespace(cn->path ? cn->path : ecb2gMapTargetName(cn->name), &fp);
+	(void)Hash_CreateEntry(&seen, cp, &new);
+	if (new) {
+	    if (Buf_Size(&buf))
+		Buf_AddByte(&buf, ' ');
+	    Buf_AddBytes(&buf, strlen(cp), (Byte *)cp);
+	}
+	free(fp);
+    }
+    Hash_DeleteTable(&seen);
+    return (char *)Buf_Destroy(&buf, FALSE);
+}
+
+/*
+ * Commands of a merged submake are replaced by its flat file.
+ */
+static int
+ecb2gNoCommands(void *cmdp, void *gnp)
+{
+    return 0;
+}
+
+/*
+ * Run the commands of an OP_MAKE target now, with the ecb2gmake
+ * wrapper told to stop after translation and report its flat file,
+ * and include the result.  Returns FALSE if nothing was merged, in
+ * which case the commands are written out as usual.
+ */
+static Boolean
+ecb2gMergeSubmake(GNode *gn, char *name)
+{
+    char alias[MAXPATHLEN], mfile[MAXPATHLEN], line[MAXPATHLEN];
+    char level[16];
+    char *p = NULL, *objdir, *oldLevel;
+    Boolean err = FALSE;
+    LstNode ln;
+    FILE *fp;
+    pid_t pid;
+    int n = 0, status = 0;
+
+    objdir = Var_Value(".OBJDIR", VAR_GLOBAL, &p);
+    n = snprintf(alias, sizeof(alias), "%s/.ECB2G_SUBMAKE.%d.%d",
+		 objdir ? objdir : ".", getpid(), ++mergeCount);
+    free(p);
+    /* a name cut short could be another submake's */
+    if (n < 0 || n >= (int)sizeof(alias) ||
+	(n = snprintf(mfile, sizeof(mfile), "%s.list", alias)) < 0 ||
+	n >= (int)sizeof(mfile))
+	return FALSE;
+    n = 0;
+    unlink(mfile);
+
+    oldLevel = getenv(ECB2G_ENV_MAKELEVEL);
+    if (oldLevel)
+	oldLevel = strdup(oldLevel);
+    snprintf(level, sizeof(level), "%d", (oldLevel ? atoi(oldLevel) : 0) + 1);
+    setenv(ECB2G_ENV_MAKELEVEL, level, 1);
+    setenv(ECB2G_ENV_MERGE_FILE, mfile, 1);
+    setenv(ECB2G_ENV_MERGE_ALIAS, alias, 1);
+    Var_EnvUpdate(NULL);
+
+    for (ln = Lst_First(gn->commands); ln && !err; ln = Lst_Succ(ln)) {
+	char *cmd = Var_Subst(NULL, (char *)Lst_Datum(ln), gn, FALSE);
+	char *cp = cmd;
+
+	while (*cp == '@' || *cp == '-' || *cp == '+' || isspace((unsigned char)*cp))
+	    cp++;
+	ecb2gDebug(1, "merging submake '%s'\n", cp);
+	if (!shellName)
+	    Shell_Init();
+	switch (pid = vFork()) {
+	case 0:
+	    Var_ExportVars();
+	    execl(shellPath, shellName, "-c", cp, (char *)NULL);
+	    _exit(1);
+	case -1:
+	    err = TRUE;
+	    break;
+	default:
+	    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+		continue;
+	    err = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+	    break;
+	}
+	if (err)
+	    ecb2gDebug(0, "%s: cannot merge '%s'\n", gn->name, cp);
+	free(cmd);
+    }
+
+    unsetenv(ECB2G_ENV_MERGE_FILE);
+    unsetenv(ECB2G_ENV_MERGE_ALIAS);
+    if (oldLevel) {
+	setenv(ECB2G_ENV_MAKELEVEL, oldLevel, 1);
+	free(oldLevel);
+    } else
+	unsetenv(ECB2G_ENV_MAKELEVEL);
+    Var_EnvUpdate(NULL);
+
+    if ((fp = fopen(mfile, "r")) == NULL)
+	return FALSE;
+    while (!err && fgets(line, sizeof(line), fp)) {
+	line[strcspn(line, "\n")] = '\0';
+	if (*line) {
+	    if (n++ == 0)
+		ecb2gPrintf("%s: %s\n", name, alias);
+	    ecb2gPrintf("include %s\n", line);
+	}
+    }
+    fclose(fp);
+    unlink(mfile);
+    return (n > 0);
+}
+
 /**********************************************************************
  * This is invoked once it is decided to create meta file for
  * a given target.
@@ -762,12 +1197,17 @@ ecb2gOut(listCallback cb, void *gnp)
     if (!ecFile) return cb;	/* If gmake translation not enabled, bail */
 
     GNode *gn = (GNode *)gnp;
-    char *name = gn->path ? gn->path : ecb2gMapTargetName(gn->name);
+    char *fp, *fb, *fe, *ff = NULL;
+    char *name = ecb2gNamespace(gn->path ? gn->path : ecb2gMapTargetName(gn->name), &fp);
+    char *b = ecb2gNamespace(".BEGIN", &fb);
+    char *e = ecb2gNamespace(".END", &fe);
+    listCallback tcb = ecb2gTargetCommands;
+    int recipe = 0;
 
     /* if this the .END or .BEGIN target, for which the default target
        as a initial and final dependency which we include in the lines
        below, we must check that there are command */
-    if (!strcmp(name, ".END") || !strcmp(name, ".BEGIN")) {
+    if (!strcmp(name, e) || !strcmp(name, b)) {
 	ecb2gPrintf(".INTERMEDIATE:%s\n", name);
     }
 
@@ -775,25 +1215,630 @@ ecb2gOut(listCallback cb, void *gnp)
     if ((gn->type & (OP_PHONY|OP_SPECIAL|OP_DEPENDS)) ||
 	!Lst_IsEmpty(gn->children) || !Lst_IsEmpty(gn->commands)) {
 
+	/* the default target also depends on .BEGIN, which would
+	   be its $< */
+	if (shareRecipes &&
+	    !(defaultTarget && !strcmp(gn->name, defaultTarget))) {
+	    char *first = NULL, *all = NULL;
+
+	    if (!Lst_IsEmpty(gn->children)) {
+		GNode *cn = (GNode *)Lst_Datum(Lst_First(gn->children));
+		first = ecb2gNamespace(cn->path ? cn->path : ecb2gMapTargetName(cn->name), &ff);
+		all = ecb2gAllPrereqs(gn);
+	    }
+	    recipe = ecb2gShareRecipe(gn, name, first, all);
+	    free(all);
+	}
+
 	if (gn->type & OP_PHONY) /* check for forced target */
 	    ecb2gPrintf("\n.PHONY: %s", name);
 
 	ecb2gPrintf("\n%s: ", name); /* target itself */
 
 	if (defaultTarget && !strcmp(gn->name, defaultTarget))
-	    ecb2gPrintf(".BEGIN "); /* Always depend on INTERMEDIATE .BEGIN target */
+	    ecb2gPrintf("%s ", b); /* Always depend on INTERMEDIATE .BEGIN target */
 
 	Lst_ForEach(gn->children, ecb2gDependencies, gn); /* Output the dependencies here */
 
 	if (defaultTarget && !strcmp(gn->name, defaultTarget))
-	    ecb2gPrintf(".END "); /* Always depend on INTERMEDIATE .END target */
+	    ecb2gPrintf("%s ", e); /* Always depend on INTERMEDIATE .END target */
 
 	ecb2gPrintf("\n");
+
+	if (recipe) {
+	    ecb2gPrintf("\t$("ECB2G_RECIPE_VAR"%d)\n", recipe);
+	    tcb = ecb2gNoCommands;
+	}
+
+	/* pull a recursive submake into this graph */
+	if (mergeSubmakes && (gn->type & OP_MAKE) &&
+	    !Lst_IsEmpty(gn->commands) && ecb2gMergeSubmake(gn, name))
+	    tcb = ecb2gNoCommands;
     }
+    free(fp);
+    free(fb);
+    free(fe);
+    free(ff);
     /*
      * Return our own callback for the commands. ecb2gTargetCommands
      * will be called once for each command line associated with
      * this target
      */
-    return ecb2gTargetCommands;
+    return tcb;
+}
+
+/**********************************************************************
+ *
+ * Translation snapshots.  With ECB2G_SNAPSHOT=<dir> a successful
+ * translation is kept in <dir>/<key>.ecb2gsnap together with what it
+ * was computed from: the makefiles read, the files make stat'ed, the
+ * directories it listed and the commands run for != and :sh.  The key
+ * covers the arguments, the directory we run in and the environment.
+ * A later run with the same key checks those inputs again and, when
+ * none of them changed, writes the saved flat file without reading a
+ * single makefile.
+ *
+ * After the "ecb2g-snapshot 1 <key>" line each input is one record:
+ *	F mtime ctime size ino len\n<name>\n	a file and its stat(2)
+ *	A len\n<name>\n				a file that did not exist
+ *	X found len\n<name>\n			only whether it exists
+ *	D count hash len\n<name>\n		the names in a directory
+ *	C failed cmdlen len\n<cmd><output>\n	a command and its output
+ * followed by the flat file "O len\n...\n", the ECB2G_OUT keys
+ * "I len\n...\n" and "end\n".
+ *
+ ***********************************************************************/
+#define SNAP_MAGIC "ecb2g-snapshot 1"
+#define SNAP_FNV_BASIS 0xcbf29ce484222325ULL
+#define SNAP_FNV_PRIME 0x100000001b3ULL
+
+typedef struct {
+    int		kind;		/* 'F', 'A' or 'X' */
+    int		found;		/* for 'X' */
+    time_t	mtime;
+    time_t	ctime;
+    off_t	size;
+    ino_t	ino;
+} SnapFile;
+
+typedef struct {
+    unsigned	count;
+    uint64_t	hash;
+} SnapDir;
+
+static Hash_Table snapFiles;	/* absolute name -> SnapFile */
+static Hash_Table snapDirs;	/* absolute name -> SnapDir */
+static Buffer snapCmds;		/* C records, in the order run */
+static char *snapFlat = NULL;	/* absolute name of our flat file */
+static char *snapFlatBase = NULL;
+static char *snapPath = NULL;	/* the snapshot for our key */
+static uint64_t snapKey;
+
+static uint64_t
+ecb2gSnapHash(const void *p, size_t len, uint64_t h)
+{
+    const unsigned char *cp = p;
+
+    while (len-- > 0)
+	h = (h ^ *cp++) * SNAP_FNV_PRIME;
+    return h;
+}
+
+/*
+ * Our flat file and the snapshots themselves are not inputs of the
+ * translation, so directory listings leave them out.
+ */
+static int
+ecb2gSnapSkip(const char *name)
+{
+    size_t len = strlen(name);
+    size_t slen = sizeof(ECB2G_SNAPSHOT_SUFFIX) - 1;
+
+    return (!strcmp(name, snapFlatBase) ||
+	    (len > slen && !strcmp(name + len - slen, ECB2G_SNAPSHOT_SUFFIX)));
+}
+
+/*
+ * Inputs are noted by absolute name since the makefiles may move us
+ * to another .OBJDIR.  Returns NULL if that name cannot be had.
+ */
+static const char *
+ecb2gSnapName(const char *name, char *buf, size_t bufsz)
+{
+    char cwd[MAXPATHLEN];
+
+    if (*name == '/')
+	return name;
+    if (!getcwd(cwd, sizeof(cwd)) ||
+	snprintf(buf, bufsz, "%s/%s", cwd, name) >= (int)bufsz)
+	return NULL;
+    return buf;
+}
+
+/*
+ * Count and hash the names in a directory, the same way for a
+ * listing read now and one make read while translating.
+ */
+static void
+ecb2gSnapListing(const char *name, SnapDir *sd)
+{
+    sd->count++;
+    sd->hash += ecb2gSnapHash(name, strlen(name), SNAP_FNV_BASIS);
+}
+
+static void
+ecb2gSnapshotInit(const char *flatfile)
+{
+    char buf[MAXPATHLEN];
+    const char *name = ecb2gSnapName(flatfile, buf, sizeof(buf));
+
+    if (!name)
+	return;
+    snapFlat = strdup(name);
+    snapFlatBase = strrchr(snapFlat, '/') + 1;
+    Hash_InitTable(&snapFiles, 0);
+    Hash_InitTable(&snapDirs, 0);
+    Buf_Init(&snapCmds, 0);
+    Buf_Init(&snapInfo, 0);
+    snapRecord = 1;
+}
+
+/*
+ * Note the state of a file make looked at; st is NULL if it did not
+ * exist.  The last look is the one that counts.  A directory's times
+ * change with every file written there, and what is in it is noted
+ * by ecb2gSnapshotDir, so for a directory only its existence counts.
+ */
+void
+ecb2gSnapshotFile(const char *name, const struct stat *st)
+{
+    char buf[MAXPATHLEN];
+    Hash_Entry *he;
+    SnapFile *sf;
+    int new;
+
+    if (!snapRecord)
+	return;
+    if ((name = ecb2gSnapName(name, buf, sizeof(buf))) == NULL) {
+	snapRecord = 0;
+	return;
+    }
+    he = Hash_CreateEntry(&snapFiles, name, &new);
+    if (new)
+	Hash_SetValue(he, bmake_malloc(sizeof(SnapFile)));
+    sf = Hash_GetValue(he);
+    if (st == NULL) {
+	sf->kind = 'A';
+    } else if (S_ISDIR(st->st_mode)) {
+	sf->kind = 'X';
+	sf->found = 1;
+    } else {
+	sf->kind = 'F';
+	sf->mtime = st->st_mtime;
+	sf->ctime = st->st_ctime;
+	sf->size = st->st_size;
+	sf->ino = st->st_ino;
+    }
+}
+
+/*
+ * Note a makefile just opened on fd.  One read from stdin cannot be
+ * checked again, so there will be no snapshot.
+ */
+void
+ecb2gSnapshotFd(const char *name, int fd)
+{
+    struct stat st;
+
+    if (!snapRecord)
+	return;
+    if (name == NULL || fstat(fd, &st) < 0)
+	snapRecord = 0;
+    else
+	ecb2gSnapshotFile(name, &st);
+}
+
+/*
+ * Note an exists() answer for an absolute name that was not found by
+ * looking at the file.
+ */
+void
+ecb2gSnapshotExists(const char *name, int found)
+{
+    Hash_Entry *he;
+    SnapFile *sf;
+    int new;
+
+    if (!snapRecord)
+	return;
+    he = Hash_CreateEntry(&snapFiles, name, &new);
+    if (!new)
+	return;
+    sf = bmake_malloc(sizeof(SnapFile));
+    sf->kind = 'X';
+    sf->found = found;
+    Hash_SetValue(he, sf);
+}
+
+/*
+ * Note the names in a directory make just read.
+ */
+void
+ecb2gSnapshotDir(const char *name, Hash_Table *files)
+{
+    char buf[MAXPATHLEN];
+    Hash_Search search;
+    Hash_Entry *he;
+    SnapDir *sd;
+    int new;
+
+    if (!snapRecord)
+	return;
+    if ((name = ecb2gSnapName(name, buf, sizeof(buf))) == NULL) {
+	snapRecord = 0;
+	return;
+    }
+    he = Hash_CreateEntry(&snapDirs, name, &new);
+    if (new)
+	Hash_SetValue(he, bmake_malloc(sizeof(SnapDir)));
+    sd = Hash_GetValue(he);
+    sd->count = 0;
+    sd->hash = 0;
+    for (he = Hash_EnumFirst(files, &search); he != NULL;
+	 he = Hash_EnumNext(&search))
+	if (!ecb2gSnapSkip(he->name))
+	    ecb2gSnapListing(he->name, sd);
+}
+
+/*
+ * Note a command run for its output.
+ */
+void
+ecb2gSnapshotCmd(const char *cmd, const char *res, int failed)
+{
+    char hdr[64];
+    size_t clen = strlen(cmd), rlen = strlen(res);
+
+    if (!snapRecord)
+	return;
+    snprintf(hdr, sizeof(hdr), "C %d %zu %zu\n", failed != 0, clen, clen + rlen);
+    Buf_AddBytes(&snapCmds, strlen(hdr), (const Byte *)hdr);
+    Buf_AddBytes(&snapCmds, clen, (const Byte *)cmd);
+    Buf_AddBytes(&snapCmds, rlen, (const Byte *)res);
+    Buf_AddByte(&snapCmds, '\n');
+}
+
+/*
+ * The make itself, then the arguments and directory in order, the
+ * environment in any order.  A rebuilt make may well translate the
+ * same makefiles differently, so its version alone will not do.
+ */
+static uint64_t
+ecb2gSnapKey(int argc, char **argv, const char *cwd)
+{
+    extern char **environ;
+    uint64_t h, env = 0, self[4];
+    struct stat st;
+    char **e, *p, *version;
+    int i;
+
+    h = SNAP_FNV_BASIS;
+    if ((version = Var_Value("MAKE_VERSION", VAR_GLOBAL, &p)) != NULL)
+	h = ecb2gSnapHash(version, strlen(version) + 1, h);
+    free(p);
+    memset(self, 0, sizeof(self));
+    if (stat("/proc/self/exe", &st) == 0 ||
+	(strchr(argv[0], '/') != NULL && stat(argv[0], &st) == 0)) {
+	self[0] = (uint64_t)st.st_dev;
+	self[1] = (uint64_t)st.st_ino;
+	self[2] = (uint64_t)st.st_size;
+	self[3] = (uint64_t)st.st_mtime;
+    }
+    h = ecb2gSnapHash(self, sizeof(self), h);
+    h = ecb2gSnapHash(cwd, strlen(cwd) + 1, h);
+    for (i = 0; i < argc; i++)
+	h = ecb2gSnapHash(argv[i], strlen(argv[i]) + 1, h);
+    for (e = environ; *e; e++)
+	env += ecb2gSnapHash(*e, strlen(*e), SNAP_FNV_BASIS);
+    return ecb2gSnapHash(&env, sizeof(env), h);
+}
+
+/*
+ * Parse a number of a record header.
+ */
+static int
+ecb2gSnapNum(char **cpp, char *end, unsigned long long *np)
+{
+    char *cp = *cpp;
+
+    if (cp < end && *cp == ' ')
+	cp++;
+    if (cp >= end || !isdigit((unsigned char)*cp))
+	return 0;
+    *np = strtoull(cp, cpp, 10);
+    return 1;
+}
+
+/*
+ * Parse the "len\n" that ends a record header and return the len bytes
+ * that follow it.
+ */
+static char *
+ecb2gSnapData(char **cpp, char *end, size_t *lenp)
+{
+    unsigned long long len;
+    char *cp;
+
+    if (!ecb2gSnapNum(cpp, end, &len))
+	return NULL;
+    cp = *cpp;
+    if (cp >= end || *cp++ != '\n' || len >= (unsigned long long)(end - cp) ||
+	cp[len] != '\n')
+	return NULL;
+    *cpp = cp + len + 1;
+    *lenp = len;
+    return cp;
+}
+
+/*
+ * Check every input recorded in a snapshot.  Returns TRUE, with the
+ * saved flat file and keys, if none of them changed.
+ */
+static Boolean
+ecb2gSnapshotCheck(char *cp, char *end, char **flatp, size_t *flatlenp,
+		   char **infop, size_t *infolenp)
+{
+    char hdr[64], name[MAXPATHLEN], *data, *cmd, *res;
+    unsigned long long n[4];
+    const char *err;
+    struct stat st;
+    struct dirent *dp;
+    SnapDir sd;
+    DIR *d;
+    size_t len;
+    int kind, i, nnum, ok;
+
+    snprintf(hdr, sizeof(hdr), SNAP_MAGIC" %016llx\n",
+	     (unsigned long long)snapKey);
+    if (end - cp < (int)strlen(hdr) + 4 || memcmp(cp, hdr, strlen(hdr)) ||
+	memcmp(end - 4, "end\n", 4))
+	return FALSE;
+    cp += strlen(hdr);
+    end -= 4;
+    *flatp = *infop = NULL;
+    while (cp < end) {
+	switch (kind = *cp++) {
+	case 'F': nnum = 4; break;
+	case 'X': nnum = 1; break;
+	case 'D': case 'C': nnum = 2; break;
+	case 'A': case 'O': case 'I': nnum = 0; break;
+	default: return FALSE;
+	}
+	for (i = 0; i < nnum; i++)
+	    if (!ecb2gSnapNum(&cp, end, &n[i]))
+		return FALSE;
+	if ((data = ecb2gSnapData(&cp, end, &len)) == NULL)
+	    return FALSE;
+
+	if (kind == 'O') {
+	    *flatp = data;
+	    *flatlenp = len;
+	    continue;
+	}
+	if (kind == 'I') {
+	    *infop = data;
+	    *infolenp = len;
+	    continue;
+	}
+	if (kind == 'C') {
+	    if (n[1] > len)
+		return FALSE;
+	    cmd = bmake_strndup(data, n[1]);
+	    res = Cmd_Exec(cmd, &err);
+	    ok = (err != NULL) == (n[0] != 0) && strlen(res) == len - n[1] &&
+		!memcmp(res, data + n[1], len - n[1]);
+	    if (!ok)
+		ecb2gDebug(1, "snapshot: output of '%s' changed\n", cmd);
+	    free(cmd);
+	    free(res);
+	    if (!ok)
+		return FALSE;
+	    continue;
+	}
+
+	if (len >= sizeof(name))
+	    return FALSE;
+	memcpy(name, data, len);
+	name[len] = '\0';
+	switch (kind) {
+	case 'F':
+	    ok = stat(name, &st) == 0 &&
+		(unsigned long long)st.st_mtime == n[0] &&
+		(unsigned long long)st.st_ctime == n[1] &&
+		(unsigned long long)st.st_size == n[2] &&
+		(unsigned long long)st.st_ino == n[3];
+	    break;
+	case 'A':
+	    ok = stat(name, &st) < 0;
+	    break;
+	case 'X':
+	    ok = (stat(name, &st) == 0) == (n[0] != 0);
+	    break;
+	default:		/* 'D' */
+	    if ((ok = (d = opendir(name)) != NULL)) {
+		sd.count = 0;
+		sd.hash = 0;
+		while ((dp = readdir(d)) != NULL)
+		    if (!ecb2gSnapSkip(dp->d_name))
+			ecb2gSnapListing(dp->d_name, &sd);
+		(void)closedir(d);
+		ok = sd.count == n[0] && sd.hash == n[1];
+	    }
+	    break;
+	}
+	if (!ok) {
+	    ecb2gDebug(1, "snapshot: %s changed\n", name);
+	    return FALSE;
+	}
+    }
+    return (*flatp != NULL && *infop != NULL);
+}
+
+/*
+ * Called once the objdir is known, before any makefile is read.  If
+ * the snapshot for this invocation is still good, write its flat file
+ * and return TRUE; there is nothing left to do.  Otherwise carry on
+ * noting the inputs of this translation for ecb2gSnapshotSave.
+ */
+int
+ecb2gSnapshotReuse(int argc, char **argv)
+{
+    char cwd[MAXPATHLEN], *buf, *flat, *info;
+    size_t flatlen, infolen = 0;
+    struct stat st;
+    int fd;
+    Boolean ok;
+
+    if (!snapRecord)
+	return FALSE;
+    if (!getcwd(cwd, sizeof(cwd))) {
+	snapRecord = 0;
+	return FALSE;
+    }
+    snapKey = ecb2gSnapKey(argc, argv, cwd);
+    if (asprintf(&snapPath, "%s%s%s/%016llx"ECB2G_SNAPSHOT_SUFFIX,
+		 *snapDir == '/' ? "" : cwd, *snapDir == '/' ? "" : "/",
+		 snapDir, (unsigned long long)snapKey) < 0) {
+	snapPath = NULL;
+	snapRecord = 0;
+	return FALSE;
+    }
+
+    if ((fd = open(snapPath, O_RDONLY)) < 0)
+	return FALSE;
+    if (fstat(fd, &st) < 0 || st.st_size == 0 ||
+	(buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+	close(fd);
+	return FALSE;
+    }
+    close(fd);
+
+    /* the commands run again to compare their output are not inputs */
+    snapRecord = 0;
+    ok = ecb2gSnapshotCheck(buf, buf + st.st_size, &flat, &flatlen,
+			    &info, &infolen);
+    if (ok) {
+	rewind(ecFile);
+	if (ftruncate(fileno(ecFile), 0) < 0 ||
+	    fwrite(flat, 1, flatlen, ecFile) != flatlen || fflush(ecFile)) {
+	    fprintf(stderr, "ecb2g: Could not write flatfile '%s' : '%s'\n",
+		    snapFlat, strerror(errno));
+	    exit(1);
+	}
+	if (ecInfoFd >= 0)
+	    (void)write(ecInfoFd, info, infolen);
+    }
+    munmap(buf, st.st_size);
+    snapRecord = !ok;
+    ecb2gDebug(1, "snapshot %s %s\n", snapPath, ok ? "reused" : "out of date");
+    return ok;
+}
+
+/*
+ * Called when the translation succeeded: save it with its inputs.
+ */
+void
+ecb2gSnapshotSave(void)
+{
+    Hash_Search search;
+    Hash_Entry *he;
+    SnapFile *sf;
+    SnapDir *sd;
+    struct stat st;
+    char *flat = NULL, *tmp, *cp;
+    FILE *fp;
+    int fd, ok;
+
+    if (!snapRecord || !snapPath)
+	return;
+#ifdef USE_META
+    /* the .meta files have a say in what is out of date */
+    if (useMeta && !skipOODate)
+	return;
+#endif
+    /*
+     * A file changed within the last second could change again
+     * without its times changing; do not save a snapshot that
+     * cannot tell.
+     */
+    for (he = Hash_EnumFirst(&snapFiles, &search); he != NULL;
+	 he = Hash_EnumNext(&search)) {
+	sf = Hash_GetValue(he);
+	if (sf->kind == 'F' && (sf->mtime >= now - 1 || sf->ctime >= now - 1)) {
+	    ecb2gDebug(1, "snapshot: %s changed too recently\n", he->name);
+	    return;
+	}
+    }
+
+    fflush(ecFile);
+    if ((fd = open(snapFlat, O_RDONLY)) < 0)
+	return;
+    if (fstat(fd, &st) < 0 || (st.st_size > 0 &&
+	(flat = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)) {
+	close(fd);
+	return;
+    }
+    close(fd);
+
+    cp = strrchr(snapPath, '/');
+    *cp = '\0';
+    (void)mkdir(snapPath, 0777);
+    *cp = '/';
+    if (asprintf(&tmp, "%.*s-%d"ECB2G_SNAPSHOT_SUFFIX,
+		 (int)(strlen(snapPath) - strlen(ECB2G_SNAPSHOT_SUFFIX)),
+		 snapPath, (int)getpid()) < 0)
+	tmp = NULL;
+    if (tmp == NULL || (fp = fopen(tmp, "w")) == NULL) {
+	if (flat)
+	    munmap(flat, st.st_size);
+	free(tmp);
+	return;
+    }
+
+    fprintf(fp, SNAP_MAGIC" %016llx\n", (unsigned long long)snapKey);
+    for (he = Hash_EnumFirst(&snapFiles, &search); he != NULL;
+	 he = Hash_EnumNext(&search)) {
+	sf = Hash_GetValue(he);
+	if (sf->kind == 'F')
+	    fprintf(fp, "F %llu %llu %llu %llu ",
+		    (unsigned long long)sf->mtime, (unsigned long long)sf->ctime,
+		    (unsigned long long)sf->size, (unsigned long long)sf->ino);
+	else if (sf->kind == 'X')
+	    fprintf(fp, "X %d ", sf->found);
+	else
+	    fprintf(fp, "A ");
+	fprintf(fp, "%zu\n%s\n", strlen(he->name), he->name);
+    }
+    for (he = Hash_EnumFirst(&snapDirs, &search); he != NULL;
+	 he = Hash_EnumNext(&search)) {
+	sd = Hash_GetValue(he);
+	fprintf(fp, "D %u %llu %zu\n%s\n", sd->count,
+		(unsigned long long)sd->hash, strlen(he->name), he->name);
+    }
+    fwrite(Buf_GetAll(&snapCmds, NULL), 1, Buf_Size(&snapCmds), fp);
+    fprintf(fp, "O %zu\n", (size_t)st.st_size);
+    if (flat)
+	fwrite(flat, 1, st.st_size, fp);
+    fprintf(fp, "\nI %d\n", Buf_Size(&snapInfo));
+    fwrite(Buf_GetAll(&snapInfo, NULL), 1, Buf_Size(&snapInfo), fp);
+    fprintf(fp, "\nend\n");
+
+    ok = !ferror(fp);
+    if (fclose(fp) == 0 && ok && rename(tmp, snapPath) == 0)
+	ecb2gDebug(1, "snapshot %s saved\n", snapPath);
+    else
+	(void)unlink(tmp);
+    if (flat)
+	munmap(flat, st.st_size);
+    free(tmp);
 }
@@ -27,10 +27,14 @@
 #define __ecb2g_h__
 #include "lst.lib/lstInt.h"
 
+struct stat;
+struct Hash_Table;
+
 typedef int (*listCallback)(void *cmdp, void *gnp);
 
 void ecb2gInit(void);
 int ecb2gEnabled(void);
+int ecb2gSkipOODate(void);
 void ecb2gSetMakefile(char *makefile);
 void ecb2gSetObjDir(char *objdir);
 
@@ -38,4 +42,12 @@ void ecb2gDefault(Lst targs, Lst vpaths);
 void ecb2gExportNotify(const char *name, char *val);
 listCallback ecb2gOut(listCallback cb, void *gnp);
 void ecb2gMetaWrite(void);
+
+int ecb2gSnapshotReuse(int argc, char **argv);
+void ecb2gSnapshotSave(void);
+void ecb2gSnapshotFile(const char *name, const struct stat *st);
+void ecb2gSnapshotFd(const char *name, int fd);
+void ecb2gSnapshotExists(const char *name, int found);
+void ecb2gSnapshotDir(const char *name, struct Hash_Table *files);
+void ecb2gSnapshotCmd(const char *cmd, const char *res, int failed);
 #endif
@@ -31,8 +31,27 @@
 #define ECB2G_ENV_CWD "ECB2G_CURRENTDIR" 
 #define ECB2G_ENV_CMDARGS "ECB2G_CMDARGS" 
 #define ECB2G_ENV_MAKELEVEL "_ECB2GMAKE_LEVEL_"
+#define ECB2G_ENV_INFO_FD "ECB2G_INFO_FD"
 
-/* Output from ecb2g are via flat file entries */
+/* Submake merging: follow OP_MAKE targets at translation time */
+#define ECB2G_ENV_MERGE "ECB2G_MERGE_SUBMAKES"
+#define ECB2G_ENV_MERGE_FILE "ECB2G_MERGE_FILE"
+#define ECB2G_ENV_MERGE_ALIAS "ECB2G_MERGE_ALIAS"
+
+/* Translate every target without checking whether it is up to date */
+#define ECB2G_ENV_NO_OODATE "ECB2G_NO_OODATE"
+
+/* Shared recipes: repeated recipes become defines using $@, $< and $^ */
+#define ECB2G_ENV_SHARE "ECB2G_SHARE_RECIPES"
+#define ECB2G_RECIPE_VAR "ecb2g_recipe_"
+#define ECB2G_AUTO_MARK '\001'
+
+/* Translation snapshots: ECB2G_SNAPSHOT names the directory holding them */
+#define ECB2G_ENV_SNAPSHOT "ECB2G_SNAPSHOT"
+#define ECB2G_SNAPSHOT_SUFFIX ".ecb2gsnap"
+
+/* Output from ecb2g are via flat file entries, repeated on the
+   ECB2G_INFO_FD pipe when the wrapper provides one */
 #define FLATFILE_OBJDIR_KEY "# ECB2G_OUT OBJDIR = "
 #define FLATFILE_SECONDARY_OBJDIR_KEY "# ECB2G_OUT SECONDARY OBJDIR = "
 #define FLATFILE_MAKEFILE_KEY "# ECB2G_OUT MAKEFILE = "
@@ -68,7 +68,7 @@ static int ecb2gmakelevel = 0;
 void buildWithEmake(char **args, int argcount, char *objdir, 
 		    char *emakefile, char *runfile);
 unsigned int getHash(char **args, char **env);
-void translate(char *fname, int argcount, char **args);
+int translate(char *fname, int argcount, char **args);
 int parseTranslatedFile(char *fname);
 
 /*
@@ -85,6 +85,38 @@ exportEcb2gmakeLevel(int level)
     }
 }
 
+/*
+ * rename(2) fails with EXDEV when the translation dir and the objdir
+ * are on different filesystems; copy the file over instead.
+ */
+static int
+moveAcross(char *from, char *to)
+{
+    char buf[65536];
+    ssize_t n;
+    int in, out, rc = -1;
+
+    if (errno != EXDEV)
+	return -1;
+    if ((in = open(from, O_RDONLY)) < 0)
+	return -1;
+    if ((out = open(to, O_WRONLY|O_CREAT|O_TRUNC, 0644)) >= 0) {
+	while ((n = read(in, buf, sizeof buf)) > 0)
+	    if (write(out, buf, n) != n)
+		break;
+	if (n == 0 && close(out) == 0)
+	    rc = 0;
+	else {
+	    close(out);
+	    unlink(to);
+	}
+    }
+    close(in);
+    if (rc == 0)
+	unlink(from);
+    return rc;
+}
+
 /*
  * One-time init function
  */
@@ -226,9 +258,16 @@ int main(int argc, char *argv[])
     char *mfile = NULL;
     /* Makefile destination */
     char *mfileDest = NULL;
+    /* Set when a parent ecb2g merges our flat file into its own */
+    char *mergeFile = NULL;
 
     ecb2gmakeInit(argc, argv);
 
+    if ((mergeFile = getenv(ECB2G_ENV_MERGE_FILE)) != NULL) {
+	mergeFile = strdup(mergeFile);
+	unsetenv(ECB2G_ENV_MERGE_FILE);
+    }
+
     ecb2gDebug(9, "pid=%d, parent=%d\n", getpid(), getppid());
 
 
@@ -266,11 +305,10 @@ int main(int argc, char *argv[])
     sprintf(fname, "%s.flat_%08X", transMakefile, hash);
     ecb2gDebug(2,"ECB2G_FLATFILE=%s\n", fname);
 
-    /* Do the translation */
-    translate(fname, new_args_count, new_args);
-
-    /* Parse the File */
-    parseTranslatedFile(fname);
+    /* Do the translation; parse the file only if ecb2g did not
+       already report the keys */
+    if (translate(fname, new_args_count, new_args))
+	parseTranslatedFile(fname);
 
     /* ********* Workaround to fix JUNOS build infra issue ********* 
      * Some targets like clean does not calculate ecb2gObjDir.
@@ -329,12 +367,24 @@ int main(int argc, char *argv[])
 
     ecb2gDebug(2,"Makefile Name is  = %s\n", transMakefile);
     ecb2gDebug(2,"New Makefile Name will be set to = %s\n", emakefile);
-    if (rename(fname, emakefile)) {
+    if (rename(fname, emakefile) && moveAcross(fname, emakefile)) {
 	ecb2gDebug(0, "Failed to rename %s to %s\n", fname, emakefile);
 	unlink(fname);
 	exit(1);
     }
 
+    /* The parent includes our flat file instead of running emake */
+    if (mergeFile) {
+	FILE *mf = fopen(mergeFile, "a");
+
+	if (!mf || fprintf(mf, "%s\n", emakefile) < 0 || fclose(mf)) {
+	    ecb2gDebug(0, "Failed to record %s in %s\n", emakefile, mergeFile);
+	    exit(1);
+	}
+	ecb2gDebug(2, "Merged %s into parent\n", emakefile);
+	_exit(0);
+    }
+
     /* Set the ecb2gmake level */
     exportEcb2gmakeLevel(ecb2gmakelevel + 1);
 
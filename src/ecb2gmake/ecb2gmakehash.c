@@ -24,6 +24,7 @@
  */
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include "ecb2gdebug.h"
@@ -138,6 +139,7 @@ getHash(char **args, char **env)
     };
     char *pwd = get_current_dir_name();
     char **evar;
+    envIndex_t ei;
     ctx_t c;
 
     hash_init(&c);
@@ -147,10 +149,13 @@ getHash(char **args, char **env)
 	args++;
     }
 
+    envIndexInit(&ei, env, 0);
     for (evar = envhash; *evar; evar++) {
 	char **val;
-	if ( val = getVal(env, *evar, -1) ) hash(&c, *val, strlen(*val));
+	/* the names in envhash[] all end with '=' */
+	if ( val = envIndexGet(&ei, *evar, strlen(*evar) - 1) ) hash(&c, *val, strlen(*val));
     }
+    free(envIndexList(&ei));
     return c.hash;
 }
 #else
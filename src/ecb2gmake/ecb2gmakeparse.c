@@ -85,6 +85,35 @@ extractMakefile(char *line)
     }
 }
 
+/*
+ * Parse the ECB2G_OUT keys ecb2g wrote to our info pipe.
+ * Returns 0 if the objdir and makefile were found.
+ */
+int
+parseTranslatedInfo(char *info)
+{
+    char *line, *nl, save;
+
+    /* lines keep their \n, as the extract functions expect */
+    for (line = info; (nl = strchr(line, '\n')) != NULL; line = nl) {
+	save = *++nl;
+	*nl = '\0';
+	if (!strncmp(line, FLATFILE_OBJDIR_KEY, strlen(FLATFILE_OBJDIR_KEY)))
+	    extractObjDir(line);
+	else if (!strncmp(line, FLATFILE_MAKEFILE_KEY, strlen(FLATFILE_MAKEFILE_KEY)))
+	    extractMakefile(line);
+	else if (!strncmp(line, FLATFILE_SECONDARY_OBJDIR_KEY,
+			  strlen(FLATFILE_SECONDARY_OBJDIR_KEY)))
+	    extractSecondaryObjDir(line);
+	*nl = save;
+    }
+    if (!strlen(ecb2gObjDir) || !strlen(ecb2gMakefile))
+	return -1;
+    ecb2gDebug(2, "Info: Makefile = %s\n", ecb2gMakefile);
+    ecb2gDebug(2, "Info: ObjDir = %s\n", ecb2gObjDir);
+    return 0;
+}
+
 /*
  * Parsing the Translated Makefile
  * The keys to look for are predefined and it is assumed to
@@ -22,6 +22,7 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/time.h>
@@ -99,6 +100,114 @@ rmVal(char **list, char *var, int two, int jmp)
     }
 }
 
+/*
+ * Length of the NAME part of a NAME=value entry
+ */
+static size_t
+envNameLen(const char *entry)
+{
+    const char *eq = strchr(entry, '=');
+    return eq ? (size_t)(eq - entry) : strlen(entry);
+}
+
+static unsigned int
+envNameHash(const char *name, size_t len)
+{
+    unsigned int h = 2166136261u;	/* FNV-1a */
+
+    while (len--)
+	h = (h ^ (unsigned char)*name++) * 16777619u;
+    return h;
+}
+
+static void
+envIndexGrow(envIndex_t *ei)
+{
+    int i;
+    unsigned int size = (ei->mask + 1) * 2;
+
+    ei->max *= 2;
+    ei->list = realloc(ei->list, (ei->max + 1) * sizeof(*ei->list));
+    free(ei->tab);
+    ei->tab = calloc(size, sizeof(*ei->tab));
+    ei->mask = size - 1;
+    for (i = 0; i < ei->n; i++) {
+	unsigned int h = envNameHash(ei->list[i], envNameLen(ei->list[i]));
+	while (ei->tab[h & ei->mask]) h++;
+	ei->tab[h & ei->mask] = i + 1;
+    }
+}
+
+/*
+ * Index env.  With replace, a later NAME= entry replaces an earlier
+ * one; otherwise the first one wins as with getVal().
+ */
+void
+envIndexInit(envIndex_t *ei, char **env, int replace)
+{
+    int n;
+
+    for (n = 0; env && env[n]; n++) /* no-op */ ;
+    ei->n = 0;
+    ei->max = n + 16;
+    ei->list = malloc((ei->max + 1) * sizeof(*ei->list));
+    for (ei->mask = 64; ei->mask < 2U * ei->max; ei->mask *= 2) /* no-op */ ;
+    ei->tab = calloc(ei->mask, sizeof(*ei->tab));
+    ei->mask--;
+    for (n = 0; env && env[n]; n++)
+	envIndexSet(ei, env[n], replace);
+}
+
+/*
+ * Find the slot holding NAME= (name need not be terminated)
+ */
+char **
+envIndexGet(envIndex_t *ei, const char *name, size_t len)
+{
+    unsigned int h = envNameHash(name, len);
+    int i;
+
+    for (; (i = ei->tab[h & ei->mask]); h++) {
+	char *e = ei->list[i - 1];
+	if (!strncmp(e, name, len) && (e[len] == '=' || !e[len]))
+	    return &ei->list[i - 1];
+    }
+    return NULL;
+}
+
+/*
+ * Add entry, or replace an existing one of the same NAME in place
+ */
+void
+envIndexSet(envIndex_t *ei, char *entry, int replace)
+{
+    size_t len = envNameLen(entry);
+    char **slot = envIndexGet(ei, entry, len);
+    unsigned int h;
+
+    if (slot) {
+	if (replace) *slot = entry;
+	return;
+    }
+    if (ei->n >= ei->max || 2U * ei->n >= ei->mask)
+	envIndexGrow(ei);
+    for (h = envNameHash(entry, len); ei->tab[h & ei->mask]; h++) /* no-op */ ;
+    ei->tab[h & ei->mask] = ei->n + 1;
+    ei->list[ei->n++] = entry;
+}
+
+/*
+ * Return the NULL terminated list; the index is no longer usable.
+ */
+char **
+envIndexList(envIndex_t *ei)
+{
+    ei->list[ei->n] = NULL;
+    free(ei->tab);
+    ei->tab = NULL;
+    return ei->list;
+}
+
 /* Utility function to check existence of a file or dir */
 int 
 isExisting(char *dir) 
@@ -42,6 +42,22 @@ char **addVal(char **list, char *val);
 /* Remove an entry from a list*/
 void rmVal(char **list, char *var, int two, int jmp);
 
+/*
+ * Hash indexed NAME=value list, used to build a child environment
+ * in a single pass instead of rescanning environ for each change.
+ */
+typedef struct envIndex_s {
+    char **list;		/* entries in order of first appearance */
+    int n, max;
+    int *tab;			/* open addressing: list index + 1 */
+    unsigned int mask;
+} envIndex_t;
+
+void envIndexInit(envIndex_t *ei, char **env, int replace);
+char **envIndexGet(envIndex_t *ei, const char *name, size_t len);
+void envIndexSet(envIndex_t *ei, char *entry, int replace);
+char **envIndexList(envIndex_t *ei);
+
 /* Utility function to check existence of a file or dir */
 int isExisting(char *dir); 
 
@@ -32,6 +32,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <stdarg.h>
+#include <sys/wait.h>
 #include <ecb2gconstants.h>
 #include "ecb2gdebug.h"
 #include "ecb2gmakeutils.h"
@@ -40,6 +41,8 @@ extern char *ecb2g;	       /* path to patched bmake (ECB2G env) */
 extern char *ecb2gmake;	       /* path to wrapper */
 extern char *ecb2g_retry_notify;       /* path to notify */
 extern char *ecb2gcwd;		/* current working dir */
+int parseTranslatedInfo(char *info);
+
 extern char *cmdArgsBuffer;
 extern char *ecb2gcwd;
 
@@ -48,7 +51,8 @@ extern char *ecb2gcwd;
 static void
 bMakeEnv(char ***argvp, char ***envp, char *fname)
 {
-    char **val;
+    char **val, **e;
+    envIndex_t ei;
 
     ecb2gDebug(7, "bMakeEnv() called with these args:\n");
     prArgs(7, *argvp);
@@ -56,10 +60,21 @@ bMakeEnv(char ***argvp, char ***envp, char *fname)
     rmVal(*argvp, "--no-print-directory", 0, -1);
     rmVal(*argvp, "-j", 1, -1);
 
-    if (val = getVal(*envp, "MAKEFLAGS", -1)) {
+    /*
+     * Build the child environment in one pass over environ; the
+     * _BMAKE_ entries are remapped below.
+     */
+    envIndexInit(&ei, NULL, 1);
+    for (e = *envp; *e; e++)
+	if (strncmp("_BMAKE_", *e, 7)) envIndexSet(&ei, *e, 1);
+
+    if (val = envIndexGet(&ei, "MAKEFLAGS", 9)) {
 	/* clean up MAKEFLAGS which gMake insists in making look like
 	   "m -- VAR=VALUE" */
-	char *sep = strstr(*val, " -- ");
+	char *sep;
+
+	*val = strdup(*val);
+	sep = strstr(*val, " -- ");
 	if (sep) memmove(*val + 10, sep + 4, strlen(sep + 4) + 1);
 	/* make(1) or emake(1) may export our --no-print-directory */
 	sep = strstr(*val, "--no-print-directory");
@@ -70,36 +85,20 @@ bMakeEnv(char ***argvp, char ***envp, char *fname)
      * Re-map the saved bmake variables to their original variables
      * i.e. All _BMAKE_<variable> are moved to <variable>.
      */
-    {
-	int i = 0;
-	char **list = *envp;
-
-	while (1) {
-	    for (i = 0; list[i]; i++) {
-		if (!strncmp("_BMAKE_", list[i], 7)) {
-		    char *name, *equal;
-		    int len;
-		    /* copy over self */
-		    list[i] = strdup(list[i] + 7);
-		    len = strlen(list[i]);
-		    if (equal = strchr(list[i], '=')) len = equal - list[i];
-		    name = strndup(list[i], len);
-		    /* remove any others like that , skipping over
-		       this one */
-		    rmVal(*envp, name, 0, i);
-		    ecb2gDebug(7, "Remapped _BMAKE_'%s' is '%s'\n", name, *getVal(*envp, name, -1));
-		    free(name);
-		    break;
-		}
-	    }
-	    if (!list[i]) break;
+    for (e = *envp; *e; e++) {
+	if (!strncmp("_BMAKE_", *e, 7)) {
+	    envIndexSet(&ei, *e + 7, 1);
+	    ecb2gDebug(7, "Remapped _BMAKE_'%.*s' is '%s'\n",
+		       (int)strcspn(*e + 7, "="), *e + 7, *e + 7);
 	}
     }
+
     {
 	char *val = malloc(strlen(fname) + 30);
 	sprintf(val, ECB2G_ENV_FLATFILE"=%s", fname);
-	*envp = addVal(*envp, val);
+	envIndexSet(&ei, val, 1);
     }
+    *envp = envIndexList(&ei);
 }
 static void
 notify(char *mfile)
@@ -137,14 +136,22 @@ notify(char *mfile)
         }
     }
 }
-void
+/*
+ * Translate the makefile into fname.  Returns 0 if ecb2g reported the
+ * ECB2G_OUT keys through the info pipe, so that the flat file does
+ * not need to be scanned for them.
+ */
+int
 translate(char *fname, int argcount, char **args)
 {
     int pid;
     struct stat stats;
     int argc = argcount;
     char **new_args = args; 
+    int info[2] = { -1, -1 };
 
+    if (pipe(info) == 0)
+	fcntl(info[0], F_SETFD, FD_CLOEXEC);
     pid = fork();
     if (pid == 0) {
 	char buf[1024];
@@ -160,7 +167,10 @@ translate(char *fname, int argcount, char **args)
 	setenv(ECB2G_ENV_FLATFILE, fname, 1);
 	setenv(ECB2G_ENV_CWD, ecb2gcwd, 1);
 	setenv(ECB2G_ENV_CMDARGS, cmdArgsBuffer, 1);
-	rmVal((char **)environ, ECB2G_ENV_FLATFILE"=", 0, -1);
+	if (info[1] >= 0) {
+	    sprintf(buf, "%d", info[1]);
+	    setenv(ECB2G_ENV_INFO_FD, buf, 1);
+	}
 
 	ecb2gDebug(6, "ecb2g ECB2G_FLATFILE=%s\n", fname);
 
@@ -177,7 +187,23 @@ translate(char *fname, int argcount, char **args)
 	exit(errno);
     } else { /* wait for the child process. */
 	int status;
-
+	char *infoBuf = NULL;
+	size_t infoLen = 0;
+
+	if (info[1] >= 0) {
+	    FILE *ip;
+
+	    close(info[1]);
+	    if ((ip = fdopen(info[0], "r")) != NULL) {
+		/* the keys are a few short lines; slurp until ecb2g exits */
+		if (getdelim(&infoBuf, &infoLen, '\0', ip) < 0) {
+		    free(infoBuf);
+		    infoBuf = NULL;
+		}
+		fclose(ip);
+	    } else
+		close(info[0]);
+	}
 	waitpid(pid, &status, 0);
 	if (WIFEXITED(status)) {
 	    int code = WEXITSTATUS(status);
@@ -196,5 +222,12 @@ translate(char *fname, int argcount, char **args)
 	    ecb2gDebug(0, "makefile '%s'\n", fname);
 	    exit(1);
 	} 
+	if (infoBuf) {
+	    int rc = parseTranslatedInfo(infoBuf);
+
+	    free(infoBuf);
+	    return rc;
+	}
     }
+    return -1;
 }
@@ -192,6 +192,8 @@ int not_parallel = 0;		    /* set if .NOT_PARALLEL */
  */
 static char *jobs_cmd = NULL;
 static Boolean jobsMaster = FALSE; /* do we own the token pool */
+static Boolean jobsGmake = FALSE;  /* pool belongs to a GNU make jobserver */
+static Boolean jobsPool = FALSE;   /* tokenWaitJob holds the token pool */
 static int jobTokensAdjust = 0;	   /* only relevant if jobs_cmd set */
 /* default interval (seconds) for running jobs_cmd */
 #ifndef DEFAULT_MAKE_JOBS_CMD_INTERVAL
@@ -1214,6 +1216,7 @@ JobFinish (Job *job, WAIT_T status)
 			     JobSaveCommand,
 			    job->node);
 	}
+	ActCache_Store(job->node);
 	job->node->made = MADE;
 	if (!(job->flags & JOB_SPECIAL))
 	    return_job_token = TRUE;
@@ -1347,7 +1350,6 @@ Job_CheckCommands(GNode *gn, void (*abortProc)(const char *, ...))
 {
     if (OP_NOP(gn->type) && Lst_IsEmpty(gn->commands) &&
 	((gn->type & OP_LIB) == 0 || Lst_IsEmpty(gn->children))) {
-        debug |= DEBUG_DIR;
 	/*
 	 * No commands. Look for .DEFAULT rule from which we might infer
 	 * commands
@@ -1498,8 +1500,7 @@ JobExec(Job *job, char **argv)
 		/*
 		 * Pass job token pipe to submakes.
 		 */
-		fcntl(tokenWaitJob.inPipe, F_SETFD, 0);
-		fcntl(tokenWaitJob.outPipe, F_SETFD, 0);		
+		Job_ServerPass();
 	}
 	
 	/*
@@ -1704,7 +1705,14 @@ JobStart(GNode *gn, int flags)
      * need to reopen it to feed it to the shell. If the -n flag *was* given,
      * we just set the file to be stdout. Cute, huh?
      */
-    if (((gn->type & OP_MAKE) && !(noRecursiveExecute)) ||
+    if (ActCache_Restore(gn)) {
+	/*
+	 * Made before from the same commands and sources, and the
+	 * outputs are back: there is nothing to run.
+	 */
+	job->cmdFILE = stdout;
+	noExec = TRUE;
+    } else if (((gn->type & OP_MAKE) && !(noRecursiveExecute)) ||
 	    (!noExecute && !touchFlag)) {
 	/*
 	 * tfile is the name of a file into which all shell commands are
@@ -2966,6 +2974,13 @@ JobTokenAdd(void)
 {
     char tok = JOB_TOKENS[aborting], tok1;
 
+    /*
+     * GNU make knows nothing of error tokens; draining its pool would
+     * only starve it.
+     */
+    if (jobsGmake)
+	tok = '+';
+
     /* If we are depositing an error token flush everything else */
     while (tok != '+' && read(tokenWaitJob.inPipe, &tok1, 1) == 1)
 	continue;
@@ -2991,6 +3006,7 @@ Job_ServerStart(int max_tokens, int jp_0, int jp_1)
     int i;
     char jobarg[64];
     
+    jobsPool = TRUE;
     if (jp_0 >= 0 && jp_1 >= 0) {
 	/* Pipe passed in from parent */
 	tokenWaitJob.inPipe = jp_0;
@@ -3010,6 +3026,14 @@ Job_ServerStart(int max_tokens, int jp_0, int jp_1)
     Var_Append(MAKEFLAGS, "-J", VAR_GLOBAL);
     Var_Append(MAKEFLAGS, jobarg, VAR_GLOBAL);			
 
+    /*
+     * Offer the same pool to any GNU make run below us; a bmake
+     * below us takes -J first and ignores this.
+     */
+    snprintf(jobarg, sizeof(jobarg), "--jobserver-auth=%d,%d",
+	    tokenWaitJob.inPipe, tokenWaitJob.outPipe);
+    Var_Append(MAKEFLAGS, jobarg, VAR_GLOBAL);
+
     /*
      * Preload the job pipe with one token per job, save the one
      * "extra" token for the primary job.
@@ -3022,6 +3046,115 @@ Job_ServerStart(int max_tokens, int jp_0, int jp_1)
 	JobTokenAdd();
 }
 
+/*-
+ *-----------------------------------------------------------------------
+ * Job_ServerPass --
+ *	Let the token pipe through to a submake about to be exec'd.
+ *	Called in the child by both JobExec and compat mode, since
+ *	MAKEFLAGS offers the pipe to every submake we run.
+ *
+ * Side Effects:
+ *	Clears close-on-exec on the token pipe, if there is one.
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+Job_ServerPass(void)
+{
+    if (!jobsPool)
+	return;
+    (void)fcntl(tokenWaitJob.inPipe, F_SETFD, 0);
+    (void)fcntl(tokenWaitJob.outPipe, F_SETFD, 0);
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * Job_ServerAuth --
+ *	Join the token pool of a GNU make jobserver, as described by the
+ *	value of its --jobserver-auth (or older --jobserver-fds) option:
+ *	either "R,W", a pair of inherited pipe descriptors, or
+ *	"fifo:PATH", a named pipe.
+ *
+ * Input:
+ *	auth		The option's value
+ *	rfdp, wfdp	Filled in with descriptors to read and write tokens
+ *
+ * Results:
+ *	TRUE if the pool could be reached.
+ *
+ * Side Effects:
+ *	The descriptors returned are our own: the read side has its own
+ *	file description, so it can be made non-blocking without
+ *	changing it under GNU make, and the inherited descriptors are
+ *	left as they were for any GNU make run below us. Tokens are from
+ *	then on returned as GNU make expects.
+ *
+ *-----------------------------------------------------------------------
+ */
+Boolean
+Job_ServerAuth(const char *auth, int *rfdp, int *wfdp)
+{
+    char path[MAXPATHLEN];
+    int rfd, wfd, fd;
+
+    if (strncmp(auth, "fifo:", 5) == 0) {
+	if ((rfd = open(auth + 5, O_RDONLY|O_NONBLOCK)) == -1)
+	    return FALSE;
+	if ((wfd = open(auth + 5, O_WRONLY)) == -1) {
+	    (void)close(rfd);
+	    return FALSE;
+	}
+    } else {
+	if (sscanf(auth, "%d,%d", &rfd, &wfd) != 2 ||
+	    fcntl(rfd, F_GETFD, 0) == -1 || fcntl(wfd, F_GETFD, 0) == -1)
+	    return FALSE;
+	/* Reopening the pipe gives us a file description of our own */
+	snprintf(path, sizeof(path), "/dev/fd/%d", rfd);
+	if ((fd = open(path, O_RDONLY|O_NONBLOCK)) == -1 &&
+	    (fd = dup(rfd)) == -1)
+	    return FALSE;
+	rfd = fd;
+	if ((wfd = dup(wfd)) == -1) {
+	    (void)close(rfd);
+	    return FALSE;
+	}
+    }
+    (void)fcntl(rfd, F_SETFL, fcntl(rfd, F_GETFL, 0) | O_NONBLOCK);
+
+    jobsGmake = TRUE;
+    *rfdp = rfd;
+    *wfdp = wfd;
+    return TRUE;
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * Job_ServerUnauth --
+ *	Leave the GNU make token pool joined by Job_ServerAuth, for
+ *	another one.
+ *
+ * Input:
+ *	rfd, wfd	The descriptors Job_ServerAuth returned
+ *
+ * Results:
+ *	None.
+ *
+ * Side Effects:
+ *	The descriptors are closed, unless they were not ours, and
+ *	tokens are again returned the way we do.
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+Job_ServerUnauth(int rfd, int wfd)
+{
+    if (!jobsGmake)
+	return;
+    (void)close(rfd);
+    (void)close(wfd);
+    jobsGmake = FALSE;
+}
+
 /*-
  *-----------------------------------------------------------------------
  * Job_TokenReturn --
@@ -3090,7 +3223,7 @@ Job_TokenWithdraw(void)
 	return FALSE;
     }
 
-    if (count == 1 && tok != '+') {
+    if (count == 1 && tok != '+' && !jobsGmake) {
 	/* make being abvorted - remove any other job tokens */
 	if (DEBUG(JOB))
 	    fprintf(debug_file, "(%d) aborted by token %c\n", getpid(), tok);
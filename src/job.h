@@ -269,6 +269,9 @@ void JobFlagForMigration(int);
 void Job_TokenReturn(void);
 Boolean Job_TokenWithdraw(void);
 void Job_ServerStart(int, int, int);
+void Job_ServerPass(void);
+Boolean Job_ServerAuth(const char *, int *, int *);
+void Job_ServerUnauth(int, int);
 void Job_SetPrefix(void);
 Boolean Job_RunTarget(const char *, const char *);
 
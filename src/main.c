@@ -202,6 +202,7 @@ char mfilename[MAXPATHLEN + 1];		/* Makefile */
 #endif
 
 Boolean forceJobs = FALSE;
+static Boolean gnuJobs = FALSE;		/* got a GNU make jobserver option */
 
 /*
  * On some systems MACHINE is defined as something other than
@@ -217,6 +218,9 @@ extern Lst parseIncPath;
 /*
  * For compatibility with the POSIX version of MAKEFLAGS that includes
  * all the options with out -, convert flags to -f -l -a -g -s.
+ * GNU make puts such a word first and follows it with other options
+ * (eg. "ks -j4 --jobserver-auth=3,4"), so only the first word is
+ * converted.
  */
 static char *
 explode(const char *flags)
@@ -232,17 +236,17 @@ explode(const char *flags)
 	if (!isalpha((unsigned char)*f))
 	    break;
 
-    if (*f)
+    if (f == flags || (*f && *f != ' '))
 	return bmake_strdup(flags);
 
     len = strlen(flags);
     st = nf = bmake_malloc(len * 3 + 1);
-    while (*flags) {
+    while (flags < f) {
 	*nf++ = '-';
 	*nf++ = *flags++;
 	*nf++ = ' ';
     }
-    *nf = '\0';
+    strcpy(nf, flags);
     return st;
 }
 	    
@@ -397,6 +401,7 @@ MainParseArgs(int argc, char **argv)
 	char *optscan;
 	Boolean inOption, dashDash = FALSE;
 	char found_path[MAXPATHLEN + 1];	/* for searching for sys.mk */
+	char jobs[16];
 
 #define OPTFLAGS "BC:D:I:J:NST:V:WXd:ef:ij:km:nqrstw"
 /* Can't actually use getopt(3) because rescanning is not portable */
@@ -431,7 +436,11 @@ rearg:
 			inOption = FALSE;
 			arginc = 1;
 			argvalue = optscan;
-			if(*argvalue == '\0') {
+			if (*argvalue == '\0' && c == 'j' && gnuJobs &&
+			    (argc < 3 || !isdigit((unsigned char)*argv[2]))) {
+				/* GNU make before 4.2 sends a bare -j */
+				argvalue = NULL;
+			} else if(*argvalue == '\0') {
 				if (argc < 3)
 					goto noarg;
 				argvalue = argv[2];
@@ -478,6 +487,11 @@ rearg:
 			break;
 		case 'J':
 			if (argvalue == NULL) goto noarg;
+			/* our parent's pool wins over a GNU make one */
+			if (jobServer) {
+			    Job_ServerUnauth(jp_0, jp_1);
+			    jobServer = FALSE;
+			}
 			if (sscanf(argvalue, "%d,%d", &jp_0, &jp_1) != 2) {
 			    (void)fprintf(stderr,
 				"%s: internal error -- J option malformed (%s)\n",
@@ -512,9 +526,17 @@ rearg:
 			break;
 		case 'T':
 			if (argvalue == NULL) goto noarg;
-			tracefile = bmake_strdup(argvalue);
+			/*
+			 * Make it absolute so that recursive makes,
+			 * which get it via MAKEFLAGS, share the file.
+			 */
+			if (*argvalue != '/' && *curdir != '\0')
+				tracefile = str_concat(curdir, argvalue,
+				    STR_ADDSLASH);
+			else
+				tracefile = bmake_strdup(argvalue);
 			Var_Append(MAKEFLAGS, "-T", VAR_GLOBAL);
-			Var_Append(MAKEFLAGS, argvalue, VAR_GLOBAL);
+			Var_Append(MAKEFLAGS, tracefile, VAR_GLOBAL);
 			break;
 		case 'V':
 			if (argvalue == NULL) goto noarg;
@@ -554,7 +576,21 @@ rearg:
 			Var_Append(MAKEFLAGS, "-i", VAR_GLOBAL);
 			break;
 		case 'j':
-			if (argvalue == NULL) goto noarg;
+			if (argvalue == NULL) {
+				/*
+				 * The jobserver is the only limit GNU
+				 * make meant; we still need one of our
+				 * own.
+				 */
+				if (!gnuJobs) goto noarg;
+				forceJobs = TRUE;
+				maxJobs = DEFMAXJOBS;
+				Var_Append(MAKEFLAGS, "-j", VAR_GLOBAL);
+				snprintf(jobs, sizeof(jobs), "%d", maxJobs);
+				Var_Set(".MAKE.JOBS", jobs, VAR_GLOBAL, 0);
+				maxJobTokens = maxJobs;
+				break;
+			}
 			forceJobs = TRUE;
 			maxJobs = strtol(argvalue, &p, 0);
 			if (*p != '\0' || maxJobs < 1) {
@@ -611,6 +647,34 @@ rearg:
 			Var_Append(MAKEFLAGS, "-w", VAR_GLOBAL);
 			break;
 		case '-':
+			/*
+			 * GNU make passes its jobserver to us this way
+			 * in MAKEFLAGS. -J, if we also got it, names the
+			 * same pool and wins; either way the option is
+			 * passed on for any GNU make below us.
+			 */
+			if (strncmp(optscan, "jobserver-auth=", 15) == 0 ||
+			    strncmp(optscan, "jobserver-fds=", 14) == 0) {
+				inOption = FALSE;
+				arginc = 1;
+				gnuJobs = TRUE;
+				if (jobServer) {
+					Var_Append(MAKEFLAGS, argv[1],
+					    VAR_GLOBAL);
+					break;
+				}
+				if (Job_ServerAuth(strchr(optscan, '=') + 1,
+				    &jp_0, &jp_1)) {
+					Var_Append(MAKEFLAGS, argv[1],
+					    VAR_GLOBAL);
+					jobServer = TRUE;
+				} else {
+					jp_0 = -1;
+					jp_1 = -1;
+					compatMake = TRUE;
+				}
+				break;
+			}
 			dashDash = TRUE;
 			break;
 		default:
@@ -745,6 +809,7 @@ Main_SetObjdir(const char *path)
 			strncpy(objdir, path, MAXPATHLEN);
 			Var_Set(".OBJDIR", objdir, VAR_GLOBAL, 0);
 			setenv("PWD", objdir, 1);
+			Var_EnvUpdate("PWD");
 			Dir_InitDot();
 			rc = TRUE;
 		}
@@ -867,6 +932,7 @@ main(int argc, char **argv)
 
 	/* default to writing debug to stderr */
 	debug_file = stderr;
+	Prof_Init();
 
 #ifdef SIGINFO
 	(void)bmake_signal(SIGINFO, siginfo);
@@ -1061,6 +1127,7 @@ main(int argc, char **argv)
 #ifdef USE_META
 	meta_init();
 #endif
+	Prof_Phase("args");
 	/*
 	 * First snag any flags out of the MAKE environment variable.
 	 * (Note this is *not* MAKEFLAGS since /bin/make uses that and it's
@@ -1140,6 +1207,7 @@ main(int argc, char **argv)
 	 * finally _PATH_OBJDIRPREFIX`pwd`, in that order.  If none
 	 * of these paths exist, just use .CURDIR.
 	 */
+	Prof_Phase("setup");
 	Dir_Init(curdir);
 	(void)Main_SetObjdir(curdir);
 
@@ -1158,6 +1226,21 @@ main(int argc, char **argv)
 			(void)Main_SetObjdir(mdpath);
 		}
 	}
+	ShCache_Init(objdir);
+
+#ifdef ECB2G
+	/* nothing changed since the last translation: reuse it */
+	Prof_Phase("snapshot");
+	if (!printVars && ecb2gSnapshotReuse(argc, argv))
+		return 0;
+#endif
+
+	Digest_Init(objdir);
+#ifdef ECB2G
+	/* a translation runs no commands */
+	if (!ecb2gEnabled())
+#endif
+		ActCache_Init(objdir);
 
 	/*
 	 * Be compatible if user did not specify -j and did not explicitly
@@ -1180,6 +1263,7 @@ main(int argc, char **argv)
 	(void)time(&now);
 
 	Trace_Log(MAKESTART, NULL);
+	Prof_Phase("parse");
 	
 	/*
 	 * Set up the .TARGETS variable to contain the list of targets to be
@@ -1330,6 +1414,7 @@ main(int argc, char **argv)
 	 * Now that all search paths have been read for suffixes et al, it's
 	 * time to add the default search path to their lists...
 	 */
+	Prof_Phase("graph");
 	Suff_DoPaths();
 
 	/*
@@ -1341,6 +1426,8 @@ main(int argc, char **argv)
 	if (DEBUG(GRAPH1))
 		Targ_PrintGraph(1);
 
+	Prof_Phase("make");
+
 	/* print the values of any variables requested by the user */
 	if (printVars) {
 		LstNode ln;
@@ -1423,6 +1510,7 @@ main(int argc, char **argv)
 		Targ_PrintGraph(2);
 
 	Trace_Log(MAKEEND, 0);
+	Prof_Phase("cleanup");
 
 	if (enterFlag)
 		printf("%s: Leaving directory `%s'\n", progname, curdir);
@@ -1436,6 +1524,10 @@ main(int argc, char **argv)
 	Job_End();
 	Trace_End();
 
+#ifdef ECB2G
+	if (!outOfDate && !printVars)
+		ecb2gSnapshotSave();
+#endif
 	return outOfDate ? 1 : 0;
 }
 
@@ -1554,6 +1646,10 @@ Cmd_Exec(const char *cmd, const char **errnum)
 
     *errnum = NULL;
 
+    /* the command may create files exists() was asked about */
+    Cond_FlushExists();
+    ShCache_Invalidate();
+
     if (!shellName)
 	Shell_Init();
     /*
@@ -1660,10 +1756,16 @@ Cmd_Exec(const char *cmd, const char **errnum)
 	}
 	break;
     }
+#ifdef ECB2G
+    ecb2gSnapshotCmd(cmd, res, *errnum != NULL);
+#endif
     return res;
 bad:
     res = bmake_malloc(1);
     *res = '\0';
+#ifdef ECB2G
+    ecb2gSnapshotCmd(cmd, res, TRUE);
+#endif
     return res;
 }
 
@@ -1941,8 +2043,10 @@ Main_ExportMAKEFLAGS(Boolean first)
     if (s && *s) {
 #ifdef POSIX
 	setenv("MAKEFLAGS", s, 1);
+	Var_EnvUpdate("MAKEFLAGS");
 #else
 	setenv("MAKE", s, 1);
+	Var_EnvUpdate("MAKE");
 #endif
     }
     if (s)
@@ -107,6 +107,10 @@ __RCSID("$NetBSD: make.c,v 1.88 2012/11/09 18:53:05 sjg Exp $");
  *	    	  	    	sure that any variable that needs to exist
  *	    	  	    	at the very least has the empty value.
  *
+ *	Make_ExpandAllSrc   	Build the .ALLSRC and .OODATE variables
+ *	    	  	    	that Make_DoAllVar left for when they are
+ *	    	  	    	first looked up.
+ *
  *	Make_OODate 	    	Determine if a target is out-of-date.
  *
  *	Make_HandleUse	    	See if a child is a .USE node for a parent
@@ -293,7 +297,8 @@ Make_OODate(GNode *gn)
 	    }
 	}
 	oodate = TRUE;
-    } else if ((gn->cmgn != NULL && gn->mtime < gn->cmgn->mtime) ||
+    } else if ((gn->cmgn != NULL && gn->mtime < gn->cmgn->mtime &&
+		!Digest_SourcesUnchanged(gn)) ||
 	       (gn->cmgn == NULL &&
 		((gn->mtime == 0 && !(gn->type & OP_OPTIONAL))
 		  || gn->type & OP_DOUBLEDEP)))
@@ -337,6 +342,13 @@ Make_OODate(GNode *gn)
     }
 #endif
 
+    /*
+     * Whatever made a target that is up-to-date made it from what its
+     * sources hold now.
+     */
+    if (!oodate)
+	Digest_Seed(gn);
+
     /*
      * If the target isn't out-of-date, the parents need to know its
      * modification time. Note that targets that appear to be out-of-date
@@ -576,6 +588,10 @@ Make_Recheck(GNode *gn)
 {
     time_t mtime = Dir_MTime(gn, 1);
 
+    Cond_FlushExists();			/* making gn may have created files */
+    ShCache_Invalidate();
+    Digest_Made(gn);
+
 #ifndef RECHECK
     /*
      * We can't re-stat the thing, but we can at least take care of rules
@@ -875,18 +891,41 @@ MakeUnmark(void *cgnp, void *pgnp MAKE_ATTR_UNUSED)
     return (0);
 }
 
+/*
+ * The ALLSRC and OODATE values being built for a node
+ */
+typedef struct {
+    GNode	*pgn;
+    Buffer	allsrc;
+    Buffer	oodate;
+    Boolean	haveAllsrc;	/* something is in allsrc */
+    Boolean	haveOodate;
+} AllSrc;
+
+/*
+ * Add a word the way Var_Append would.
+ */
+static void
+MakeAllSrcAdd(Buffer *buf, Boolean *have, const char *word)
+{
+    if (*have)
+	Buf_AddByte(buf, ' ');
+    Buf_AddBytes(buf, strlen(word), word);
+    *have = TRUE;
+}
+
 /*
  * Input:
  *	cgnp		The child to add
- *	pgnp		The parent to whose ALLSRC variable it should
- *			be added
+ *	asp		The values being built for the parent
  *
  */
 static int
-MakeAddAllSrc(void *cgnp, void *pgnp)
+MakeAddAllSrc(void *cgnp, void *asp)
 {
     GNode	*cgn = (GNode *)cgnp;
-    GNode	*pgn = (GNode *)pgnp;
+    AllSrc	*as = (AllSrc *)asp;
+    GNode	*pgn = as->pgn;
 
     if (cgn->type & OP_MARK)
 	return (0);
@@ -906,14 +945,14 @@ MakeAddAllSrc(void *cgnp, void *pgnp)
 	    allsrc = child;
 	}
 	if (allsrc != NULL)
-		Var_Append(ALLSRC, allsrc, pgn);
+	    MakeAllSrcAdd(&as->allsrc, &as->haveAllsrc, allsrc);
 	if (p2)
 	    free(p2);
 	if (pgn->type & OP_JOIN) {
 	    if (cgn->made == MADE) {
-		Var_Append(OODATE, child, pgn);
+		MakeAllSrcAdd(&as->oodate, &as->haveOodate, child);
 	    }
-	} else if ((pgn->mtime < cgn->mtime) ||
+	} else if ((pgn->srcmtime < cgn->mtime) ||
 		   (cgn->mtime >= now && cgn->made == MADE))
 	{
 	    /*
@@ -932,14 +971,82 @@ MakeAddAllSrc(void *cgnp, void *pgnp)
 	     * since cgn->mtime is set to now in Make_Update. According to
 	     * some people, this is good...
 	     */
-	    Var_Append(OODATE, child, pgn);
+	    MakeAllSrcAdd(&as->oodate, &as->haveOodate, child);
 	}
 	if (p1)
 	    free(p1);
     }
     return (0);
 }
-
+
+/*
+ * Sum the length of the children's names, to size the ALLSRC buffer.
+ */
+static int
+MakeAllSrcLen(void *cgnp, void *lenp)
+{
+    GNode	*cgn = (GNode *)cgnp;
+
+    *(int *)lenp += strlen(cgn->path ? cgn->path : cgn->name) + 1;
+    return (0);
+}
+
+/*
+ * Start a value with what the variable already holds, if anything.
+ */
+static void
+MakeAllSrcInit(Buffer *buf, Boolean *have, const char *name, GNode *gn,
+	       int size)
+{
+    char *p1 = NULL;
+    char *val = Var_Value(name, gn, &p1);
+
+    Buf_Init(buf, size);
+    *have = FALSE;
+    if (val != NULL)
+	MakeAllSrcAdd(buf, have, val);
+    if (p1)
+	free(p1);
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * Make_ExpandAllSrc --
+ *	Build the ALLSRC and OODATE variables of a node. Make_DoAllVar
+ *	leaves this until one of them is first looked up, since most
+ *	commands use neither, and each holds a word per child.
+ *
+ * Results:
+ *	None
+ *
+ * Side Effects:
+ *	The ALLSRC and OODATE variables of the given node are filled in.
+ *-----------------------------------------------------------------------
+ */
+void
+Make_ExpandAllSrc(GNode *gn)
+{
+    AllSrc	as;
+    int		len = 0;
+
+    if ((gn->flags & LAZY_ALLSRC) == 0)
+	return;
+    gn->flags &= ~LAZY_ALLSRC;
+
+    Lst_ForEach(gn->children, MakeAllSrcLen, &len);
+    as.pgn = gn;
+    MakeAllSrcInit(&as.allsrc, &as.haveAllsrc, ALLSRC, gn, len + 1);
+    MakeAllSrcInit(&as.oodate, &as.haveOodate, OODATE, gn, 0);
+
+    Lst_ForEach(gn->children, MakeUnmark, gn);
+    Lst_ForEach(gn->children, MakeAddAllSrc, &as);
+
+    Var_Set(ALLSRC, (char *)Buf_GetAll(&as.allsrc, NULL), gn, 0);
+    Var_Set(OODATE, (char *)Buf_GetAll(&as.oodate, NULL), gn, 0);
+    Buf_Destroy(&as.allsrc, TRUE);
+    Buf_Destroy(&as.oodate, TRUE);
+}
+
 /*-
  *-----------------------------------------------------------------------
  * Make_DoAllVar --
@@ -953,6 +1060,10 @@ MakeAddAllSrc(void *cgnp, void *pgnp)
  *	variable. As for ALLSRC, the ordering is important and not
  *	guaranteed when in native mode, so it must be set here, too.
  *
+ *	The variables themselves are only built, by Make_ExpandAllSrc,
+ *	when they are first looked up; the parent's modification time
+ *	is noted now for OODATE.
+ *
  * Results:
  *	None
  *
@@ -968,15 +1079,8 @@ Make_DoAllVar(GNode *gn)
     if (gn->flags & DONE_ALLSRC)
 	return;
     
-    Lst_ForEach(gn->children, MakeUnmark, gn);
-    Lst_ForEach(gn->children, MakeAddAllSrc, gn);
-
-    if (!Var_Exists (OODATE, gn)) {
-	Var_Set(OODATE, "", gn, 0);
-    }
-    if (!Var_Exists (ALLSRC, gn)) {
-	Var_Set(ALLSRC, "", gn, 0);
-    }
+    gn->srcmtime = gn->mtime;
+    gn->flags |= DONE_ALLSRC | LAZY_ALLSRC;
 
     if (gn->type & OP_JOIN) {
 	char *p1;
@@ -984,9 +1088,8 @@ Make_DoAllVar(GNode *gn)
 	if (p1)
 	    free(p1);
     }
-    gn->flags |= DONE_ALLSRC;
 }
-
+
 /*-
  *-----------------------------------------------------------------------
  * MakeStartJobs --
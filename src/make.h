@@ -133,6 +133,10 @@
 #include "make-conf.h"
 #include "buf.h"
 #include "make_malloc.h"
+#include "profile.h"
+#include "shcache.h"
+#include "digest.h"
+#include "actcache.h"
 
 /*
  * some vendors don't have this --sjg
@@ -192,6 +196,7 @@ typedef struct GNode {
 #define DONE_ORDER	0x10	/* Build requested by .ORDER processing */
 #define FROM_DEPEND	0x20	/* Node created from .depend */
 #define DONE_ALLSRC	0x40	/* We do it once only */
+#define LAZY_ALLSRC	0x80	/* ALLSRC and OODATE not built yet */
 #define CYCLE		0x1000  /* Used by MakePrintStatus */
 #define DONECYCLE	0x2000  /* Used by MakePrintStatus */
     enum enum_made {
@@ -218,6 +223,7 @@ typedef struct GNode {
     int             unmade;    	/* The number of unmade children */
 
     time_t          mtime;     	/* Its modification time */
+    time_t	    srcmtime;	/* mtime as of Make_DoAllVar, for OODATE */
     struct GNode    *cmgn;    	/* The youngest child */
 
     Lst     	    iParents;  	/* Links to parents for which this is an
@@ -440,7 +446,8 @@ extern int	makelevel;
  * We cannot vfork() in a child of vfork().
  * Most systems do not enforce this but some do.
  */
-#define vFork() ((getpid() == myPid) ? vfork() : fork())
+#define vFork() (PROF_COUNT(PROF_FORKS), \
+    (getpid() == myPid) ? vfork() : fork())
 extern pid_t	myPid;
 
 #define	MAKEFLAGS	".MAKEFLAGS"
@@ -456,6 +463,25 @@ extern pid_t	myPid;
 # define MAKE_LEVEL_ENV	"MAKELEVEL"
 #endif
 
+/*
+ * A Str_Match pattern, prepared by Str_PatternInit for matching many
+ * strings.
+ */
+typedef struct StrPattern {
+    const char	*pattern;	/* the pattern itself */
+    int		kind;		/* STR_PAT_* */
+    const char	*lit;		/* literal part, for the fast paths */
+    size_t	len;		/* length of lit */
+    size_t	prefix;		/* STR_PAT_GLOB: literal text before the */
+    size_t	suffix;		/* first and after the last special char */
+} StrPattern;
+#define STR_PAT_GLOB	0	/* anything else */
+#define STR_PAT_ALL	1	/* "*" */
+#define STR_PAT_EXACT	2	/* "lit" */
+#define STR_PAT_PREFIX	3	/* "lit*" */
+#define STR_PAT_SUFFIX	4	/* "*lit" */
+#define STR_PAT_CONTAINS 5	/* "*lit*" */
+
 /*
  * debug control:
  *	There is one bit per module.  It is up to the module what debug
@@ -497,6 +523,7 @@ time_t Make_Recheck(GNode *);
 void Make_HandleUse(GNode *, GNode *);
 void Make_Update(GNode *);
 void Make_DoAllVar(GNode *);
+void Make_ExpandAllSrc(GNode *);
 Boolean Make_Run(Lst);
 char * Check_Cwd_Cmd(const char *);
 void Check_Cwd(const char **);
@@ -1245,14 +1245,16 @@ meta_oodate(GNode *gn, Boolean oodate)
 				fprintf(debug_file, "%s: %d: found: %s\n", fname, lineno, p);
 #endif
 			    if (!S_ISDIR(fs.st_mode) &&
-				fs.st_mtime > gn->mtime) {
+				fs.st_mtime > gn->mtime &&
+				!Digest_InputUnchanged(gn, p, &fs)) {
 				if (DEBUG(META))
 				    fprintf(debug_file, "%s: %d: file '%s' is newer than the target...\n", fname, lineno, p);
 				oodate = TRUE;
 			    } else if (S_ISDIR(fs.st_mode)) {
 				/* Update the latest directory. */
 				realpath(p, latestdir);
-			    }
+			    } else
+				Digest_InputSeen(gn, p, &fs);
 			} else if (errno == ENOENT && *p == '/' &&
 				   strncmp(p, cwd, cwdlen) != 0) {
 			    /*
@@ -1432,4 +1434,108 @@ meta_compat_parent(void)
     fclose(fp);
 }
 
+/*
+ * Report the files the .meta file of gn says were read ('R') and
+ * written ('W'), as absolute names; the .meta file itself counts as
+ * written.
+ * Return TRUE only if this make wrote the file and it has a filemon
+ * section that names them all: not when there is no file, no filemon
+ * (as without filemon(4)), a process changed directory, or a line is
+ * bad.
+ */
+Boolean
+meta_files(GNode *gn, void (*fn)(int, const char *, void *), void *arg)
+{
+    static char *buf = NULL;
+    static size_t bufsz;
+    char fname[MAXPATHLEN];
+    char cwd[MAXPATHLEN];
+    char path[MAXPATHLEN];
+    char *p, *q;
+    struct stat fs;
+    FILE *fp;
+    int f = 0;
+    int x;
+    Boolean ok = TRUE;
+
+    meta_name(gn, fname, sizeof(fname), NULL, NULL);
+    if ((fp = fopen(fname, "r")) == NULL)
+	return FALSE;
+    if (fstat(fileno(fp), &fs) == -1 || fs.st_mtime < now) {
+	fclose(fp);			/* left by another */
+	return FALSE;
+    }
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+	fclose(fp);
+	return FALSE;
+    }
+    if (!buf) {
+	bufsz = 8 * BUFSIZ;
+	buf = bmake_malloc(bufsz);
+    }
+    while (ok && (x = fgetLine(&buf, &bufsz, 0, fp)) > 0) {
+	if (buf[x - 1] != '\n') {
+	    ok = FALSE;
+	    break;
+	}
+	buf[x - 1] = '\0';
+	if (!f) {
+	    if (strncmp(buf, "-- filemon", 10) == 0 ||
+		strncmp(buf, "# buildmon", 10) == 0)
+		f = 1;
+	    continue;
+	}
+	/* <key> <pid> <data> */
+	p = buf;
+	strsep(&p, " ");
+	if (p == NULL || strsep(&p, " ") == NULL) {
+	    if (buf[0] != '#' && buf[0] != 'V' && buf[0] != 'X')
+		ok = FALSE;
+	    continue;
+	}
+	switch (buf[0]) {
+	case 'C':		/* Chdir: relative names are lost */
+	    ok = FALSE;
+	    continue;
+	case 'M':		/* Move */
+	case 'L':		/* Link */
+	    if ((q = p) == NULL || strsep(&q, " ") == NULL || q == NULL) {
+		ok = FALSE;
+		continue;
+	    }
+	    DEQUOTE(q);
+	    p = q;
+	    /* FALLTHROUGH */
+	case 'W':		/* Write */
+	case 'R':		/* Read */
+	case 'E':		/* Exec */
+	    if (p == NULL || *p == '\0') {
+		ok = FALSE;
+		continue;
+	    }
+	    if (*p != '/') {
+		if ((size_t)snprintf(path, sizeof(path), "%s/%s", cwd, p) >=
+		    sizeof(path)) {
+		    ok = FALSE;
+		    continue;
+		}
+		p = path;
+	    }
+	    if (buf[0] == 'R' || buf[0] == 'E') {
+		if (Lst_ForEach(metaIgnorePaths, prefix_match, p))
+		    continue;
+		fn('R', p, arg);
+	    } else
+		fn('W', p, arg);
+	    break;
+	default:
+	    break;
+	}
+    }
+    fclose(fp);
+    if (ok && f)
+	fn('W', fname, arg);
+    return ok && f;
+}
+
 #endif	/* USE_META */
@@ -50,6 +50,7 @@ void meta_job_output(struct Job *, char *, const char *);
 void meta_cmd_finish(void *);
 void meta_job_finish(struct Job *);
 Boolean meta_oodate(GNode *, Boolean);
+Boolean meta_files(GNode *, void (*)(int, const char *, void *), void *);
 void meta_compat_start(void);
 void meta_compat_child(void);
 void meta_compat_parent(void);
@@ -95,6 +95,7 @@ int Cond_EvalExpression(const struct If *, char *, Boolean *, int);
 int Cond_Eval(char *);
 void Cond_restore_depth(unsigned int);
 unsigned int Cond_save_depth(void);
+void Cond_FlushExists(void);
 
 /* for.c */
 int For_Eval(char *);
@@ -139,6 +140,8 @@ char *str_concat(const char *, const char *, int);
 char **brk_string(const char *, int *, Boolean, char **);
 char *Str_FindSubstring(const char *, const char *);
 int Str_Match(const char *, const char *);
+void Str_PatternInit(StrPattern *, const char *);
+int Str_PatternMatch(const StrPattern *, const char *);
 char *Str_SYSVMatch(const char *, const char *, int *len);
 void Str_SYSVSubst(Buffer *, char *, char *, int);
 
@@ -193,6 +196,7 @@ void Var_End(void);
 void Var_Dump(GNode *);
 void Var_ExportVars(void);
 void Var_Export(char *, int);
+void Var_EnvUpdate(const char *);
 void Var_UnExport(char *);
 
 /* util.c */
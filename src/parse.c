@@ -125,6 +125,7 @@ __RCSID("$NetBSD: parse.c,v 1.193 2014/01/10 16:12:52 christos Exp $");
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
@@ -138,6 +139,9 @@ __RCSID("$NetBSD: parse.c,v 1.193 2014/01/10 16:12:52 christos Exp $");
 #include "job.h"
 #include "buf.h"
 #include "pathnames.h"
+#ifdef ECB2G
+#include "ecb2g.h"
+#endif
 
 #ifdef HAVE_MMAP
 #include <sys/mman.h>
@@ -436,6 +440,65 @@ loadedfile_nextbuf(void *x, size_t *len)
 	return lf->buf;
 }
 
+/*
+ * Start the kernel reading ahead the files this one is going to
+ * .include, so that their data is already on its way into the page
+ * cache by the time the parser reaches each directive. Only names in
+ * double quotes with no variable references can be resolved this
+ * early, and only as absolute paths or relative to the including file,
+ * which is where Parse_include_file looks first. Nothing is parsed or
+ * remembered here, so evaluation is exactly as it was.
+ */
+static void
+loadedfile_prefetch(struct loadedfile *lf)
+{
+#ifdef POSIX_FADV_WILLNEED
+	const char *cp, *nl, *end, *name, *dir;
+	char path[MAXPATHLEN];
+	int dirlen, namelen, fd;
+
+	dir = strrchr(lf->path, '/');
+	dirlen = dir != NULL ? (int)(dir - lf->path) : 0;
+
+	end = lf->buf + lf->len;
+	for (cp = lf->buf; cp < end; cp = nl + 1) {
+		nl = memchr(cp, '\n', end - cp);
+		if (nl == NULL)
+			nl = end;
+		if (*cp++ != '.')
+			continue;
+		while (cp < nl && (*cp == ' ' || *cp == '\t'))
+			cp++;
+		if (cp < nl && (*cp == 's' || *cp == '-'))
+			cp++;
+		if (nl - cp < 8 || strncmp(cp, "include", 7) != 0)
+			continue;
+		for (cp += 7; cp < nl && (*cp == ' ' || *cp == '\t'); cp++)
+			continue;
+		if (cp == nl || *cp != '"')
+			continue;
+		name = ++cp;
+		if ((cp = memchr(name, '"', nl - name)) == NULL)
+			continue;
+		namelen = (int)(cp - name);
+		if (namelen == 0 || memchr(name, '$', namelen) != NULL)
+			continue;
+
+		if (*name == '/' || dir == NULL)
+			snprintf(path, sizeof(path), "%.*s", namelen, name);
+		else
+			snprintf(path, sizeof(path), "%.*s/%.*s",
+			    dirlen, lf->path, namelen, name);
+		if ((fd = open(path, O_RDONLY)) == -1)
+			continue;
+		if (DEBUG(PARSE))
+			fprintf(debug_file, "Prefetching %s\n", path);
+		(void)posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+		(void)close(fd);
+	}
+#endif
+}
+
 /*
  * Try to get the size of a file.
  */
@@ -504,6 +567,9 @@ loadfile(const char *path, int fd)
 		}
 #endif
 	}
+#ifdef ECB2G
+	ecb2gSnapshotFd(path, fd);
+#endif
 
 #ifdef HAVE_MMAP
 	if (load_getsize(fd, &lf->len) == SUCCESS) {
@@ -578,8 +644,10 @@ loadfile(const char *path, int fd)
 #ifdef HAVE_MMAP
 done:
 #endif
+	PROF_COUNT(PROF_FILES);
 	if (path != NULL) {
 		close(fd);
+		loadedfile_prefetch(lf);
 	}
 	return lf;
 }
@@ -2175,6 +2243,7 @@ Parse_include_file(char *file, Boolean isSystem, int silent)
 
     /* load it */
     lf = loadfile(fullname, fd);
+    PROF_COUNT(PROF_INCLUDES);
 
     ParseSetIncludedFile();
     /* Start reading from this file next */
@@ -2523,6 +2592,7 @@ ParseGmakeExport(char *line)
      */
     value = Var_Subst(NULL, value, VAR_CMD, FALSE);
     setenv(variable, value, 1);
+    Var_EnvUpdate(variable);
 }
 #endif
 
@@ -2882,6 +2952,10 @@ Parse_File(const char *name, int fd)
     char	  *cp;		/* pointer into the line */
     char          *line;	/* the line we're working on */
     struct loadedfile *lf;
+    struct timeval start, stop;
+
+    if (DEBUG(PARSE))
+	gettimeofday(&start, NULL);
 
     lf = loadfile(name, fd);
 
@@ -2897,6 +2971,7 @@ Parse_File(const char *name, int fd)
 
     do {
 	for (; (line = ParseReadLine()) != NULL; ) {
+	    PROF_COUNT(PROF_LINES);
 	    if (DEBUG(PARSE))
 		fprintf(debug_file, "ParseReadLine (%d): '%s'\n",
 			curFile->lineno, line);
@@ -3094,6 +3169,13 @@ Parse_File(const char *name, int fd)
 	 */
     } while (ParseEOF() == CONTINUE);
 
+    if (DEBUG(PARSE)) {
+	gettimeofday(&stop, NULL);
+	fprintf(debug_file, "Parse_File: %s: %.3f seconds\n", name,
+		(stop.tv_sec - start.tv_sec) +
+		(stop.tv_usec - start.tv_usec) / 1e6);
+    }
+
     if (fatals) {
 	(void)fflush(stdout);
 	(void)fprintf(stderr,
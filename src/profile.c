@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2014, Juniper Networks, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*-
+ * profile.c --
+ *	Record where a single invocation of make spends its time.
+ *
+ *	When MAKE_PROFILE names a file, the time at which each phase of
+ *	main() starts is recorded, and at exit one line of JSON holding
+ *	the phase durations and a handful of counters is appended to
+ *	that file. Recursive makes inherit the variable and append
+ *	their own line, so a whole tree of invocations can be examined
+ *	afterwards; ppid ties each record to its parent.
+ *
+ * Interface:
+ *	Prof_Init		Note the start time and open the output
+ *				file (called once, first thing in main).
+ *
+ *	Prof_Phase		Mark the start of a new phase, ending the
+ *				previous one.
+ *
+ *	Prof_End		Write the record. Registered with atexit
+ *				so that every way out of make is covered.
+ *
+ *	PROF_COUNT		Bump one of the counters in profile.h.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <sys/time.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "make.h"
+
+#define PROF_MAX_PHASES	16
+
+unsigned long prof_count[PROF_NCOUNTERS];
+
+static const char *counter_name[PROF_NCOUNTERS] = {
+	"files",
+	"includes",
+	"lines",
+	"var_set",
+	"var_subst",
+	"stats",
+	"forks",
+	"shcache_dir_hits",
+	"shcache_dir_misses",
+	"shcache_exists_hits",
+	"shcache_exists_misses",
+	"digests",
+	"digest_bytes",
+	"action_hits",
+	"action_misses",
+};
+
+static int prof_fd = -1;
+static pid_t prof_pid;
+static double prof_epoch;		/* wall clock time at Prof_Init */
+static double prof_start;		/* monotonic time at Prof_Init */
+static char prof_cwd[MAXPATHLEN];
+static int prof_nphases;
+static struct {
+	const char *name;
+	double start;
+} prof_phase[PROF_MAX_PHASES];
+
+static double
+prof_now(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+	{
+		struct timeval tv;
+
+		gettimeofday(&tv, NULL);
+		return tv.tv_sec + tv.tv_usec / 1e6;
+	}
+}
+
+static void
+prof_add(Buffer *buf, const char *s)
+{
+	Buf_AddBytes(buf, strlen(s), (const Byte *)s);
+}
+
+static void
+prof_add_string(Buffer *buf, const char *s)
+{
+	char hex[8];
+
+	Buf_AddByte(buf, '"');
+	for (; *s != '\0'; s++) {
+		if (*s == '"' || *s == '\\') {
+			Buf_AddByte(buf, '\\');
+			Buf_AddByte(buf, *s);
+		} else if ((unsigned char)*s < 0x20) {
+			snprintf(hex, sizeof(hex), "\\u%04x", (unsigned char)*s);
+			prof_add(buf, hex);
+		} else
+			Buf_AddByte(buf, *s);
+	}
+	Buf_AddByte(buf, '"');
+}
+
+void
+Prof_Init(void)
+{
+	struct timeval tv;
+	const char *path;
+
+	if ((path = getenv("MAKE_PROFILE")) == NULL || *path == '\0')
+		return;
+	prof_fd = open(path, O_WRONLY|O_APPEND|O_CREAT, 0666);
+	if (prof_fd == -1)
+		return;
+	(void)fcntl(prof_fd, F_SETFD, FD_CLOEXEC);
+
+	prof_pid = getpid();
+	gettimeofday(&tv, NULL);
+	prof_epoch = tv.tv_sec + tv.tv_usec / 1e6;
+	prof_start = prof_now();
+	if (getcwd(prof_cwd, sizeof(prof_cwd)) == NULL)
+		prof_cwd[0] = '\0';
+	Prof_Phase("init");
+	atexit(Prof_End);
+}
+
+void
+Prof_Phase(const char *name)
+{
+	if (prof_fd == -1 || prof_nphases == PROF_MAX_PHASES)
+		return;
+	prof_phase[prof_nphases].name = name;
+	prof_phase[prof_nphases].start = prof_now() - prof_start;
+	prof_nphases++;
+}
+
+void
+Prof_End(void)
+{
+	Buffer buf;
+	char num[64];
+	double end;
+	int i, len;
+	Byte *data;
+
+	/* Only the process that called Prof_Init reports */
+	if (prof_fd == -1 || getpid() != prof_pid)
+		return;
+	end = prof_now() - prof_start;
+
+	Buf_Init(&buf, 0);
+	snprintf(num, sizeof(num), "{\"pid\":%ld,\"ppid\":%ld,\"level\":%d,",
+	    (long)prof_pid, (long)getppid(), makelevel);
+	prof_add(&buf, num);
+	prof_add(&buf, "\"prog\":");
+	prof_add_string(&buf, progname != NULL ? progname : "");
+	prof_add(&buf, ",\"cwd\":");
+	prof_add_string(&buf, prof_cwd);
+	snprintf(num, sizeof(num), ",\"start\":%.6f,\"elapsed\":%.6f,",
+	    prof_epoch, end);
+	prof_add(&buf, num);
+
+	prof_add(&buf, "\"phases\":[");
+	for (i = 0; i < prof_nphases; i++) {
+		prof_add(&buf, i > 0 ? ",{\"name\":" : "{\"name\":");
+		prof_add_string(&buf, prof_phase[i].name);
+		snprintf(num, sizeof(num), ",\"start\":%.6f,\"dur\":%.6f}",
+		    prof_phase[i].start,
+		    (i + 1 < prof_nphases ? prof_phase[i + 1].start : end) -
+		    prof_phase[i].start);
+		prof_add(&buf, num);
+	}
+
+	prof_add(&buf, "],\"counters\":{");
+	for (i = 0; i < PROF_NCOUNTERS; i++) {
+		snprintf(num, sizeof(num), "%s\"%s\":%lu", i > 0 ? "," : "",
+		    counter_name[i], prof_count[i]);
+		prof_add(&buf, num);
+	}
+	prof_add(&buf, "}}\n");
+
+	/* One write, so records from concurrent makes do not interleave */
+	data = Buf_GetAll(&buf, &len);
+	(void)write(prof_fd, data, len);
+	Buf_Destroy(&buf, TRUE);
+	(void)close(prof_fd);
+	prof_fd = -1;
+}
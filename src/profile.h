@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2014, Juniper Networks, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*-
+ * profile.h --
+ *	Definitions for the phase profiler.
+ */
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+typedef enum {
+	PROF_FILES,		/* makefiles loaded, includes and all */
+	PROF_INCLUDES,		/* .include directives satisfied */
+	PROF_LINES,		/* logical lines parsed */
+	PROF_VAR_SET,		/* calls to Var_Set */
+	PROF_VAR_SUBST,		/* calls to Var_Subst */
+	PROF_STATS,		/* stat(2) calls made by the dir module */
+	PROF_FORKS,		/* child processes started */
+	PROF_SHC_DIR_HITS,	/* directories read from the shared cache */
+	PROF_SHC_DIR_MISSES,	/* ... and looked for there in vain */
+	PROF_SHC_EXISTS_HITS,	/* exists() answered by the shared cache */
+	PROF_SHC_EXISTS_MISSES,	/* ... and looked for there in vain */
+	PROF_DIGESTS,		/* files read for their content digest */
+	PROF_DIGEST_BYTES,	/* ... and the bytes in them */
+	PROF_ACTION_HITS,	/* targets restored from the action cache */
+	PROF_ACTION_MISSES,	/* ... and looked for there in vain */
+	PROF_NCOUNTERS
+} ProfCounter;
+
+extern unsigned long prof_count[PROF_NCOUNTERS];
+
+/* Counting is unconditional; it is cheaper than testing a flag. */
+#define PROF_COUNT(c)	(prof_count[(c)]++)
+
+void Prof_Init(void);
+void Prof_Phase(const char *);
+void Prof_End(void);
+
+#endif /* _PROFILE_H_ */
@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2014, Juniper Networks, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*-
+ * shcache.c --
+ *	A cache shared by a make and every make it starts.
+ *
+ *	When MAKE_SHARED_CACHE is set, the top-level make creates a file
+ *	in its .OBJDIR (or at the path the variable gives), maps it, and
+ *	points the variable at the file; recursive makes inherit the
+ *	variable and map the same file. Directory listings and exists()
+ *	answers found by one make are then found by all the others
+ *	without reading the directory or stat'ing the file again.
+ *
+ *	Entries are only ever appended, and are published by a single
+ *	store of the head of a hash chain, so looking one up takes no
+ *	lock; adding one is serialized by a lock on the file. When the
+ *	file is full nothing more is added. Stale entries are not
+ *	removed but shadowed: lookups find the newest entry for a key
+ *	and check that it is still valid (see shcache.h).
+ *
+ * Interface:
+ *	ShCache_Init		Map the cache, creating it if need be.
+ *
+ *	ShCache_Active		Whether there is a cache to use.
+ *
+ *	ShCache_Get		Look up a valid entry.
+ *
+ *	ShCache_Put		Add an entry.
+ *
+ *	ShCache_Generation	The generation to pass to ShCache_Put,
+ *				taken before looking up what to add.
+ *
+ *	ShCache_Invalidate	Start a new generation, after files may
+ *				have been created.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "make.h"
+
+#define SHC_ENV		"MAKE_SHARED_CACHE"
+#define SHC_FILE	".make.shcache"
+#define SHC_MAGIC	0x62736863	/* "bshc" */
+#define SHC_VERSION	1
+#define SHC_SIZE	(16 * 1024 * 1024)
+#define SHC_NBUCKETS	8192
+#define SHC_NSTAMP	4
+
+struct shc_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;			/* of the whole file */
+	volatile uint32_t generation;
+	volatile uint32_t used;		/* end of the last entry */
+	volatile uint32_t bucket[SHC_NBUCKETS]; /* chain heads, 0 if none */
+};
+
+struct shc_entry {
+	uint32_t next;			/* older entry in the chain, or 0 */
+	uint32_t hash;
+	uint32_t category;
+	uint32_t generation;		/* when the entry was added */
+	uint64_t stamp[SHC_NSTAMP];	/* of the file, or all 0 */
+	uint32_t keylen;
+	uint32_t vallen;
+	char data[1];			/* key, NUL, value, NUL */
+};
+
+static const ProfCounter shc_hits[SHC_NCATEGORIES] = {
+	PROF_SHC_DIR_HITS, PROF_SHC_EXISTS_HITS
+};
+static const ProfCounter shc_misses[SHC_NCATEGORIES] = {
+	PROF_SHC_DIR_MISSES, PROF_SHC_EXISTS_MISSES
+};
+
+static struct shc_header *shc = NULL;
+static int shc_fd = -1;
+static char *shc_unlink = NULL;		/* the file to remove at exit */
+static pid_t shc_pid;
+
+static uint32_t
+shc_hash(const char *key, size_t len)
+{
+	uint32_t h = 2166136261U;
+
+	while (len-- > 0)
+		h = (h ^ (unsigned char)*key++) * 16777619U;
+	return h;
+}
+
+static void
+shc_stamp(uint64_t *stamp, const struct stat *st)
+{
+	memset(stamp, 0, SHC_NSTAMP * sizeof(*stamp));
+	if (st == NULL)
+		return;
+	stamp[0] = (uint64_t)st->st_dev;
+	stamp[1] = (uint64_t)st->st_ino;
+	stamp[2] = (uint64_t)st->st_mtime;
+	stamp[3] = (uint64_t)st->st_ctime;
+}
+
+static int
+shc_lock(int type)
+{
+	struct flock fl;
+
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = type;
+	fl.l_whence = SEEK_SET;
+	while (fcntl(shc_fd, F_SETLKW, &fl) == -1) {
+		if (errno != EINTR)
+			return -1;
+	}
+	return 0;
+}
+
+static void
+shc_end(void)
+{
+	/* Only the make that created the file removes it */
+	if (shc_unlink != NULL && getpid() == shc_pid)
+		(void)unlink(shc_unlink);
+}
+
+void
+ShCache_Init(const char *objdir)
+{
+#ifdef HAVE_MMAP
+	struct stat st;
+	const char *env;
+	char path[MAXPATHLEN];
+	Boolean created = FALSE;
+	void *map;
+
+	if ((env = getenv(SHC_ENV)) == NULL || *env == '\0')
+		return;
+	if (*env == '/')
+		snprintf(path, sizeof(path), "%s", env);
+	else
+		snprintf(path, sizeof(path), "%s/%s", objdir, SHC_FILE);
+
+	if ((shc_fd = open(path, O_RDWR|O_CREAT|O_EXCL, 0666)) != -1) {
+		created = TRUE;
+		if (ftruncate(shc_fd, SHC_SIZE) == -1)
+			goto fail;
+	} else if ((shc_fd = open(path, O_RDWR)) == -1)
+		return;
+	(void)fcntl(shc_fd, F_SETFD, FD_CLOEXEC);
+	if (fstat(shc_fd, &st) == -1 || st.st_size < SHC_SIZE)
+		goto fail;
+	map = mmap(NULL, SHC_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED,
+	    shc_fd, 0);
+	if (map == MAP_FAILED)
+		goto fail;
+	shc = map;
+
+	if (created) {
+		shc->version = SHC_VERSION;
+		shc->size = SHC_SIZE;
+		shc->generation = 1;
+		shc->used = sizeof(*shc);
+		__sync_synchronize();
+		shc->magic = SHC_MAGIC;
+	} else if (shc->magic != SHC_MAGIC || shc->version != SHC_VERSION ||
+	    shc->size != SHC_SIZE) {
+		(void)munmap(map, SHC_SIZE);
+		shc = NULL;
+		goto fail;
+	} else if (makelevel == 0) {
+		/*
+		 * Left by an earlier run, which was killed before it
+		 * could remove it; files may have changed since.
+		 */
+		ShCache_Invalidate();
+	}
+	if (*env != '/' && (created || makelevel == 0)) {
+		shc_pid = getpid();
+		shc_unlink = bmake_strdup(path);
+		atexit(shc_end);
+	}
+	/* so that recursive makes map this file rather than their own */
+	setenv(SHC_ENV, path, 1);
+	Var_EnvUpdate(SHC_ENV);
+	if (DEBUG(DIR))
+		fprintf(debug_file, "Shared cache %s%s\n", path,
+		    created ? " (created)" : "");
+	return;
+fail:
+	if (created)
+		(void)unlink(path);
+	(void)close(shc_fd);
+	shc_fd = -1;
+#endif
+}
+
+Boolean
+ShCache_Active(void)
+{
+	return shc != NULL;
+}
+
+const char *
+ShCache_Get(ShCacheCategory cat, const char *key, const struct stat *st,
+    size_t *lenp)
+{
+	struct shc_entry *e;
+	uint64_t stamp[SHC_NSTAMP];
+	uint32_t h, off;
+	size_t keylen;
+
+	if (shc == NULL)
+		return NULL;
+	keylen = strlen(key);
+	h = shc_hash(key, keylen);
+	off = shc->bucket[h % SHC_NBUCKETS];
+	/* see the entries as they were when published */
+	__sync_synchronize();
+	for (; off != 0; off = e->next) {
+		if (off > SHC_SIZE - sizeof(*e))
+			break;
+		e = (struct shc_entry *)((char *)shc + off);
+		if (e->hash != h || e->category != (uint32_t)cat ||
+		    e->keylen != keylen || memcmp(e->data, key, keylen) != 0)
+			continue;
+		/* the newest entry for the key decides */
+		shc_stamp(stamp, st);
+		if (memcmp(e->stamp, stamp, sizeof(stamp)) != 0 ||
+		    (st == NULL && e->generation != shc->generation))
+			break;
+		PROF_COUNT(shc_hits[cat]);
+		*lenp = e->vallen;
+		return e->data + keylen + 1;
+	}
+	PROF_COUNT(shc_misses[cat]);
+	return NULL;
+}
+
+void
+ShCache_Put(ShCacheCategory cat, const char *key, const struct stat *st,
+    unsigned int gen, const char *val, size_t vallen)
+{
+	struct shc_entry *e;
+	size_t keylen, need;
+	uint32_t h, off;
+
+	if (shc == NULL || shc_lock(F_WRLCK) == -1)
+		return;
+	if (st == NULL && gen != shc->generation) {
+		/* the answer may predate files made since */
+		(void)shc_lock(F_UNLCK);
+		return;
+	}
+	keylen = strlen(key);
+	need = offsetof(struct shc_entry, data) + keylen + vallen + 2;
+	off = (shc->used + 7) & ~7U;
+	if (need <= SHC_SIZE && off <= SHC_SIZE - need) {
+		e = (struct shc_entry *)((char *)shc + off);
+		h = shc_hash(key, keylen);
+		e->hash = h;
+		e->category = cat;
+		e->generation = gen;
+		shc_stamp(e->stamp, st);
+		e->keylen = keylen;
+		e->vallen = vallen;
+		memcpy(e->data, key, keylen + 1);
+		memcpy(e->data + keylen + 1, val, vallen);
+		e->data[keylen + 1 + vallen] = '\0';
+		e->next = shc->bucket[h % SHC_NBUCKETS];
+		/* the entry must be complete before anyone can see it */
+		__sync_synchronize();
+		shc->bucket[h % SHC_NBUCKETS] = off;
+		shc->used = off + need;
+	}
+	(void)shc_lock(F_UNLCK);
+}
+
+unsigned int
+ShCache_Generation(void)
+{
+	return shc != NULL ? shc->generation : 0;
+}
+
+void
+ShCache_Invalidate(void)
+{
+	if (shc != NULL)
+		(void)__sync_fetch_and_add(&shc->generation, 1);
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2014, Juniper Networks, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*-
+ * shcache.h --
+ *	Definitions for the cache shared between recursive makes.
+ */
+
+#ifndef _SHCACHE_H_
+#define _SHCACHE_H_
+
+struct stat;
+
+/*
+ * What an entry holds. Entries added with a stat buffer are only
+ * returned while the file still stats the same; the others only until
+ * the next ShCache_Invalidate by any of the makes sharing the cache.
+ */
+typedef enum {
+	SHC_DIR,		/* NUL-separated names in a directory */
+	SHC_EXISTS,		/* path exists() found for a file, or "" */
+	SHC_NCATEGORIES
+} ShCacheCategory;
+
+void ShCache_Init(const char *);
+Boolean ShCache_Active(void);
+const char *ShCache_Get(ShCacheCategory, const char *, const struct stat *,
+    size_t *);
+void ShCache_Put(ShCacheCategory, const char *, const struct stat *,
+    unsigned int, const char *, size_t);
+unsigned int ShCache_Generation(void);
+void ShCache_Invalidate(void);
+
+#endif /* _SHCACHE_H_ */
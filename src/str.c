@@ -145,6 +145,7 @@ brk_string(const char *str, int *store_argc, Boolean expand, char **buffer)
 	const char *p;
 	int len;
 	int argmax = 50, curlen = 0;
+	size_t run;
     	char **argv;
 
 	/* skip leading space chars. */
@@ -168,6 +169,17 @@ brk_string(const char *str, int *store_argc, Boolean expand, char **buffer)
 	argc = 0;
 	inquote = '\0';
 	for (p = str, start = t = *buffer;; ++p) {
+		/*
+		 * copy a run of ordinary characters in one go; strcspn
+		 * is vectorized in most C libraries.
+		 */
+		if ((run = strcspn(p, " \t\n\"'\\")) > 0) {
+			if (!start)
+				start = t;
+			memcpy(t, p, run);
+			t += run;
+			p += run;
+		}
 		switch(ch = *p) {
 		case '"':
 		case '\'':
@@ -332,6 +344,7 @@ Str_FindSubstring(const char *string, const char *substring)
 int
 Str_Match(const char *string, const char *pattern)
 {
+	const char *starp = NULL, *stars = NULL;
 	char c2;
 
 	for (;;) {
@@ -340,27 +353,33 @@ Str_Match(const char *string, const char *pattern)
 		 * string. If, we succeeded.  If we're at the end of the
 		 * pattern but not at the end of the string, we failed.
 		 */
-		if (*pattern == 0)
-			return(!*string);
-		if (*string == 0 && *pattern != '*')
-			return(0);
+		if (*pattern == 0) {
+			if (*string == 0)
+				return(1);
+			goto backtrack;
+		}
 		/*
 		 * Check for a "*" as the next pattern character.  It matches
-		 * any substring.  We handle this by calling ourselves
-		 * recursively for each postfix of string, until either we
-		 * match or we reach the end of the string.
+		 * any substring.  Rather than recursing for each postfix
+		 * of string, remember where the "*" was and come back to
+		 * let it take one more character whenever the rest of the
+		 * pattern fails.  Only the last "*" ever needs to be
+		 * retried, since it can take up whatever an earlier one
+		 * would have.  The rest of the pattern must match at
+		 * least one character.
 		 */
 		if (*pattern == '*') {
 			pattern += 1;
 			if (*pattern == 0)
 				return(1);
-			while (*string != 0) {
-				if (Str_Match(string, pattern))
-					return(1);
-				++string;
-			}
-			return(0);
+			if (*string == 0)
+				return(0);
+			starp = pattern;
+			stars = string;
+			continue;
 		}
+		if (*string == 0)
+			goto backtrack;
 		/*
 		 * Check for a "?" as the next pattern character.  It matches
 		 * any single character.
@@ -376,13 +395,13 @@ Str_Match(const char *string, const char *pattern)
 			++pattern;
 			for (;;) {
 				if ((*pattern == ']') || (*pattern == 0))
-					return(0);
+					goto backtrack;
 				if (*pattern == *string)
 					break;
 				if (pattern[1] == '-') {
 					c2 = pattern[2];
 					if (c2 == 0)
-						return(0);
+						goto backtrack;
 					if ((*pattern <= *string) &&
 					    (c2 >= *string))
 						break;
@@ -404,17 +423,126 @@ Str_Match(const char *string, const char *pattern)
 		if (*pattern == '\\') {
 			++pattern;
 			if (*pattern == 0)
-				return(0);
+				goto backtrack;
 		}
 		/*
 		 * There's no special character.  Just make sure that the
 		 * next characters of each string match.
 		 */
 		if (*pattern != *string)
-			return(0);
+			goto backtrack;
 thisCharOK:	++pattern;
 		++string;
+		continue;
+backtrack:
+		/*
+		 * Let the last "*" take one more character, as long as
+		 * that leaves something for the rest of the pattern.
+		 */
+		if (starp == NULL || *++stars == 0)
+			return(0);
+		pattern = starp;
+		string = stars;
+	}
+}
+
+/*
+ * Str_PatternInit --
+ *
+ * Prepare pattern for matching many strings with Str_PatternMatch.
+ * Patterns that are a literal, or a literal with a single leading
+ * and/or trailing "*", are matched with strcmp, memcmp or strstr.
+ * Otherwise the literal text before the first and after the last
+ * special character is checked before running Str_Match.
+ *
+ * Side effects: pat refers to pattern, which must outlive it.
+ */
+void
+Str_PatternInit(StrPattern *pat, const char *pattern)
+{
+	const char *cp, *first, *last;
+	size_t len;
+
+	pat->pattern = pattern;
+	pat->prefix = pat->suffix = 0;
+	len = strlen(pattern);
+	first = strpbrk(pattern, "*?[\\");
+	if (first == NULL) {
+		pat->kind = STR_PAT_EXACT;
+		pat->lit = pattern;
+		pat->len = len;
+		return;
+	}
+	/* a literal, bracketed by single stars */
+	cp = pattern + (*pattern == '*');
+	last = cp + strcspn(cp, "*?[\\");
+	if (last[0] == '*' && last[1] == 0 && last != cp) {
+		pat->kind = cp == pattern ? STR_PAT_PREFIX : STR_PAT_CONTAINS;
+		pat->lit = cp;
+		pat->len = last - cp;
+		return;
+	}
+	if (*last == 0 && cp != pattern) {
+		pat->kind = cp == last ? STR_PAT_ALL : STR_PAT_SUFFIX;
+		pat->lit = cp;
+		pat->len = last - cp;
+		return;
+	}
+	pat->kind = STR_PAT_GLOB;
+	pat->prefix = first - pattern;
+	/*
+	 * The literal tail.  Str_Match runs off the end of an
+	 * unterminated [, so leave any pattern with one to it.
+	 */
+	cp = pattern + len;
+	if (strchr(first, '[') == NULL) {
+		while (cp > first && strchr("*?\\", cp[-1]) == NULL)
+			cp--;
+	}
+	pat->suffix = pattern + len - cp;
+	pat->lit = cp;
+}
+
+/*
+ * Str_PatternMatch --
+ *
+ * Results: The same as Str_Match(string, pat->pattern).
+ *
+ * Side effects: None.
+ */
+int
+Str_PatternMatch(const StrPattern *pat, const char *string)
+{
+	size_t len;
+
+	switch (pat->kind) {
+	case STR_PAT_ALL:
+		return(1);
+	case STR_PAT_EXACT:
+		return(strcmp(string, pat->lit) == 0);
+	case STR_PAT_PREFIX:
+		return(strncmp(string, pat->lit, pat->len) == 0);
+	case STR_PAT_CONTAINS:
+		for (; (string = strchr(string, *pat->lit)) != NULL; string++) {
+			if (strncmp(string, pat->lit, pat->len) == 0)
+				return(1);
+		}
+		return(0);
+	case STR_PAT_SUFFIX:
+		len = strlen(string);
+		return(len >= pat->len &&
+		    memcmp(string + len - pat->len, pat->lit, pat->len) == 0);
+	}
+	if (strncmp(string, pat->pattern, pat->prefix) != 0)
+		return(0);
+	if (pat->suffix) {
+		len = strlen(string);
+		if (len < pat->prefix + pat->suffix ||
+		    memcmp(string + len - pat->suffix, pat->lit,
+		    pat->suffix) != 0)
+			return(0);
 	}
+	return(Str_Match(string + pat->prefix, pat->pattern + pat->prefix));
 }
 
 
@@ -211,6 +211,48 @@ static Suff 	    *suffNull;	/* The NULL suffix for this run */
 static Suff 	    *emptySuff;	/* The empty suffix required for POSIX
 				 * single-suffix transformation rules */
 
+/*
+ * Index of the suffix names, stored reversed so that all the suffixes
+ * of a target name can be found in a single walk from its end.
+ * It is rebuilt on demand whenever suffGen has moved on.
+ */
+typedef struct _SuffTrie {
+    struct _SuffTrie *child;	/* First node one character further left */
+    struct _SuffTrie *sib;	/* Next node at the same depth */
+    Suff	     *suff;	/* Suffix whose name starts here, if any */
+    char	      c;	/* Character matched by this node */
+} SuffTrie;
+
+static SuffTrie	    *suffTrie;	/* Root of the index */
+static int	     suffTrieMax; /* Most suffixes a name can match */
+static Suff	   **suffMatch;	/* Scratch for SuffTrieMatch, suffTrieMax long */
+
+/*
+ * One step of the breadth-first walk through the transformation graph
+ * done by SuffFindThem, recorded so that the walk need not be repeated
+ * (and its Src structures allocated) for every target with the same
+ * suffixes. The file looked for is the prefix of the root followed by
+ * the name of the suffix (or just the prefix for a bare step).
+ */
+typedef struct {
+    Suff	    *suff;	/* Suffix of the file to look for */
+    int		     parent;	/* Step we are a source for, -1 for the root */
+    int		     root;	/* Index of the root target in targs */
+    Boolean	     bare;	/* Look for the prefix alone (.NULL suffix) */
+} SuffStep;
+
+typedef struct {
+    int		     nsteps;	/* Number of steps, 0 if nothing to try */
+    SuffStep	    *steps;	/* The walk, in the order SuffFindThem uses */
+} SuffPlan;
+
+#define SUFF_PLAN_MAX	1024	/* Don't memoize walks longer than this */
+
+static Hash_Table    suffPlans;	/* SuffPlan's keyed by the root suffixes */
+static int	     suffGen;	/* Bumped whenever the suffix graph changes */
+static int	     suffTrieGen = -1; /* suffGen when suffTrie was built */
+static int	     suffPlanGen = -1; /* suffGen when suffPlans was flushed */
+
 
 static const char *SuffStrIsPrefix(const char *, const char *);
 static char *SuffSuffIsSuffix(const Suff *, const SuffixCmpData *);
@@ -239,6 +281,11 @@ static void SuffFindNormalDeps(GNode *, Lst);
 static int SuffPrintName(void *, void *);
 static int SuffPrintSuff(void *, void *);
 static int SuffPrintTrans(void *, void *);
+static void SuffTrieFree(SuffTrie *);
+static void SuffTrieBuild(void);
+static int SuffTrieMatch(const char *, int, Boolean);
+static SuffPlan *SuffGetPlan(Lst);
+static Src *SuffFindPlanned(SuffPlan *, Lst, Lst);
 
 	/*************** Lst Predicates ****************/
 /*-
@@ -396,6 +443,135 @@ SuffGNHasNameP(const void *gn, const void *name)
     return (strcmp(name, ((const GNode *)gn)->name));
 }
 
+	    /************** Suffix Index ***************/
+
+/*-
+ *-----------------------------------------------------------------------
+ * SuffTrieFree --
+ *	Free a (sub)tree of the suffix index.
+ *
+ * Results:
+ *	None
+ *
+ * Side Effects:
+ *	The memory is free'd.
+ *-----------------------------------------------------------------------
+ */
+static void
+SuffTrieFree(SuffTrie *t)
+{
+    SuffTrie *next;
+
+    for (; t != NULL; t = next) {
+	next = t->sib;
+	SuffTrieFree(t->child);
+	free(t);
+    }
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * SuffTrieBuild --
+ *	Make sure the suffix index reflects the current sufflist.
+ *
+ * Results:
+ *	None
+ *
+ * Side Effects:
+ *	suffTrie, suffTrieMax and suffMatch may be rebuilt.
+ *-----------------------------------------------------------------------
+ */
+static void
+SuffTrieBuild(void)
+{
+    LstNode	ln;
+    Suff	*s;
+    SuffTrie	*t, *n;
+    char	*cp;
+
+    if (suffTrieGen == suffGen)
+	return;
+
+    SuffTrieFree(suffTrie);
+    suffTrie = bmake_malloc(sizeof(SuffTrie));
+    memset(suffTrie, 0, sizeof(SuffTrie));
+    suffTrieMax = 1;
+
+    for (ln = Lst_First(sufflist); ln != NULL; ln = Lst_Succ(ln)) {
+	s = (Suff *)Lst_Datum(ln);
+	t = suffTrie;
+	for (cp = s->name + s->nameLen; cp > s->name; ) {
+	    cp--;
+	    for (n = t->child; n != NULL && n->c != *cp; n = n->sib)
+		continue;
+	    if (n == NULL) {
+		n = bmake_malloc(sizeof(SuffTrie));
+		memset(n, 0, sizeof(SuffTrie));
+		n->c = *cp;
+		n->sib = t->child;
+		t->child = n;
+	    }
+	    t = n;
+	}
+	t->suff = s;
+	if (s->nameLen + 1 > suffTrieMax)
+	    suffTrieMax = s->nameLen + 1;
+    }
+    free(suffMatch);
+    suffMatch = bmake_malloc(suffTrieMax * sizeof(Suff *));
+    suffTrieGen = suffGen;
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * SuffTrieMatch --
+ *	Find the known suffixes of the given name. This replaces a scan
+ *	of sufflist with SuffSuffIsSuffix.
+ *
+ * Input:
+ *	name		name to look at
+ *	len		its length
+ *	exact		only the suffix which is the whole name will do
+ *
+ * Results:
+ *	The number of suffixes found. They are left in suffMatch, in
+ *	the order of sufflist.
+ *
+ * Side Effects:
+ *	The index is rebuilt if needed.
+ *-----------------------------------------------------------------------
+ */
+static int
+SuffTrieMatch(const char *name, int len, Boolean exact)
+{
+    SuffTrie	*t;
+    Suff	*s;
+    int		n, i;
+
+    SuffTrieBuild();
+
+    n = 0;
+    t = suffTrie;
+    if (t->suff != NULL && (!exact || len == 0))
+	suffMatch[n++] = t->suff;
+    while (len > 0 && t != NULL) {
+	len--;
+	for (t = t->child; t != NULL && t->c != name[len]; t = t->sib)
+	    continue;
+	if (t != NULL && t->suff != NULL && (!exact || len == 0)) {
+	    /*
+	     * Keep them in sufflist order; there are only ever a few.
+	     */
+	    s = t->suff;
+	    for (i = n; i > 0 && suffMatch[i - 1]->sNum > s->sNum; i--)
+		suffMatch[i] = suffMatch[i - 1];
+	    suffMatch[i] = s;
+	    n++;
+	}
+    }
+    return n;
+}
+
  	    /*********** Maintenance Functions ************/
 
 static void
@@ -407,6 +583,7 @@ SuffUnRef(void *lp, void *sp)
     if (ln != NULL) {
 	Lst_Remove(l, ln);
 	((Suff *)sp)->refCount--;
+	suffGen++;
     }
 }
 
@@ -433,6 +610,8 @@ SuffFree(void *sp)
     if (s == emptySuff)
 	emptySuff = NULL;
 
+    suffGen++;
+
 #ifdef notdef
     /* We don't delete suffixes in order, so we cannot use this */
     if (s->refCount)
@@ -516,6 +695,7 @@ SuffInsert(Lst l, Suff *s)
 	(void)Lst_AtEnd(l, s);
 	s->refCount++;
 	(void)Lst_AtEnd(s->ref, l);
+	suffGen++;
     } else if (s2->sNum != s->sNum) {
 	if (DEBUG(SUFF)) {
 	    fprintf(debug_file, "before %s(%d)\n", s2->name, s2->sNum);
@@ -523,6 +703,7 @@ SuffInsert(Lst l, Suff *s)
 	(void)Lst_InsertBefore(l, ln, s);
 	s->refCount++;
 	(void)Lst_AtEnd(s->ref, l);
+	suffGen++;
     } else if (DEBUG(SUFF)) {
 	fprintf(debug_file, "already there\n");
     }
@@ -554,6 +735,7 @@ Suff_ClearSuffixes(void)
     sufflist = Lst_Init(FALSE);
     sNum = 0;
     suffNull = emptySuff;
+    suffGen++;
 }
 
 /*-
@@ -979,6 +1161,7 @@ Suff_AddSuffix(char *str, GNode **gn)
 	s->refCount =	1;
 
 	(void)Lst_AtEnd(sufflist, s);
+	suffGen++;
 	/*
 	 * We also look at our existing targets list to see if adding
 	 * this suffix will make one of our current targets mutate into
@@ -1388,6 +1571,307 @@ SuffFindThem(Lst srcs, Lst slst)
     return (rs);
 }
 
+/*-
+ *-----------------------------------------------------------------------
+ * SuffPlanFlush --
+ *	Forget all the memoized transformation walks.
+ *
+ * Results:
+ *	None
+ *
+ * Side Effects:
+ *	The plans are free'd and suffPlans emptied.
+ *-----------------------------------------------------------------------
+ */
+static void
+SuffPlanFlush(void)
+{
+    Hash_Search	search;
+    Hash_Entry	*he;
+    SuffPlan	*plan;
+
+    for (he = Hash_EnumFirst(&suffPlans, &search); he != NULL;
+	 he = Hash_EnumNext(&search)) {
+	if ((plan = (SuffPlan *)Hash_GetValue(he)) != NULL) {
+	    free(plan->steps);
+	    free(plan);
+	}
+    }
+    Hash_DeleteTable(&suffPlans);
+    Hash_InitTable(&suffPlans, 0);
+    suffPlanGen = suffGen;
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * SuffPlanAddLevel --
+ *	The SuffAddLevel of a plan: add a step for each suffix we can
+ *	transform into that of the given step.
+ *
+ * Input:
+ *	plan		plan being built
+ *	suff		suffix of the step being expanded
+ *	parent		index of that step, -1 for a root
+ *	root		index of the root the step belongs to
+ *
+ * Results:
+ *	FALSE if the plan got too long.
+ *
+ * Side Effects:
+ *	plan->steps may be reallocated.
+ *-----------------------------------------------------------------------
+ */
+static Boolean
+SuffPlanAddLevel(SuffPlan *plan, Suff *suff, int parent, int root)
+{
+    LstNode	ln;
+    Suff	*s;
+    SuffStep	*st;
+    int		bare;
+
+    for (ln = Lst_First(suff->children); ln != NULL; ln = Lst_Succ(ln)) {
+	s = (Suff *)Lst_Datum(ln);
+	/*
+	 * Like SuffAddSrc, a .NULL suffix is also tried with no suffix
+	 * at all.
+	 */
+	for (bare = ((s->flags & SUFF_NULL) && *s->name != '\0'); bare >= 0;
+	     bare--) {
+	    if (plan->nsteps >= SUFF_PLAN_MAX)
+		return FALSE;
+	    if ((plan->nsteps & 31) == 0)
+		plan->steps = bmake_realloc(plan->steps,
+		    (plan->nsteps + 32) * sizeof(SuffStep));
+	    st = &plan->steps[plan->nsteps++];
+	    st->suff = s;
+	    st->parent = parent;
+	    st->root = root;
+	    st->bare = bare;
+	}
+    }
+    return TRUE;
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * SuffGetPlan --
+ *	Find the walk through the transformation graph for a target with
+ *	the given possible suffixes, computing it if this is the first
+ *	target with those suffixes since the graph last changed.
+ *
+ * Input:
+ *	targs		list of Src structures for the target, one per
+ *			suffix it could have
+ *
+ * Results:
+ *	The plan, or NULL if the walk is too long to memoize (the graph
+ *	may well have a cycle) and SuffFindThem should be used.
+ *
+ * Side Effects:
+ *	The plan is remembered in suffPlans.
+ *-----------------------------------------------------------------------
+ */
+static SuffPlan *
+SuffGetPlan(Lst targs)
+{
+    Buffer	key;
+    LstNode	ln;
+    Hash_Entry	*he;
+    SuffPlan	*plan;
+    Boolean	isNew;
+    char	num[32];
+    int		i, len, root;
+
+    if (suffPlanGen != suffGen)
+	SuffPlanFlush();
+
+    /*
+     * The suffixes are not freed without suffGen changing, so their
+     * addresses are good enough to name them.
+     */
+    Buf_Init(&key, 0);
+    for (ln = Lst_First(targs); ln != NULL; ln = Lst_Succ(ln)) {
+	len = snprintf(num, sizeof(num), "%p ",
+		       (void *)((Src *)Lst_Datum(ln))->suff);
+	Buf_AddBytes(&key, len, (Byte *)num);
+    }
+    he = Hash_CreateEntry(&suffPlans, (char *)Buf_GetAll(&key, NULL), &isNew);
+    Buf_Destroy(&key, TRUE);
+    if (!isNew)
+	return (SuffPlan *)Hash_GetValue(he);
+
+    plan = bmake_malloc(sizeof(SuffPlan));
+    plan->nsteps = 0;
+    plan->steps = NULL;
+
+    root = 0;
+    for (ln = Lst_First(targs); ln != NULL; ln = Lst_Succ(ln), root++) {
+	if (!SuffPlanAddLevel(plan, ((Src *)Lst_Datum(ln))->suff, -1, root))
+	    goto toolong;
+    }
+    for (i = 0; i < plan->nsteps; i++) {
+	if (!SuffPlanAddLevel(plan, plan->steps[i].suff, i,
+			      plan->steps[i].root))
+	    goto toolong;
+    }
+    if (DEBUG(SUFF)) {
+	fprintf(debug_file, "\tmemoized %d step transformation search\n",
+		plan->nsteps);
+    }
+    Hash_SetValue(he, plan);
+    return plan;
+
+toolong:
+    free(plan->steps);
+    free(plan);
+    Hash_SetValue(he, NULL);
+    return NULL;
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * SuffPlanSrc --
+ *	Create the Src structures for a step of a plan and for the steps
+ *	leading to it from its root.
+ *
+ * Input:
+ *	plan		plan being followed
+ *	i		index of the step
+ *	roots		Src structures of the roots
+ *	slst		list to which intermediate structures go
+ *
+ * Results:
+ *	The Src structure for the step.
+ *
+ * Side Effects:
+ *	Src structures are allocated, all but the last are put on slst.
+ *-----------------------------------------------------------------------
+ */
+static Src *
+SuffPlanSrc(SuffPlan *plan, int i, Src **roots, Lst slst)
+{
+    SuffStep	*st = &plan->steps[i];
+    Src		*targ;
+    Src		*s2;
+
+    if (st->parent < 0) {
+	targ = roots[st->root];
+    } else {
+	targ = SuffPlanSrc(plan, st->parent, roots, slst);
+	(void)Lst_AtEnd(slst, targ);
+    }
+
+    s2 = bmake_malloc(sizeof(Src));
+    if (st->bare)
+	s2->file = bmake_strdup(targ->pref);
+    else
+	s2->file = str_concat(targ->pref, st->suff->name, 0);
+    s2->pref = targ->pref;
+    s2->parent = targ;
+    s2->node = NULL;
+    s2->suff = st->suff;
+    s2->suff->refCount++;
+    s2->children = 0;
+    targ->children += 1;
+#ifdef DEBUG_SRC
+    s2->cp = Lst_Init(FALSE);
+    Lst_AtEnd(targ->cp, s2);
+#endif
+    return s2;
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * SuffFindPlanned --
+ *	Equivalent of SuffAddLevel on each of targs followed by
+ *	SuffFindThem, using a memoized plan of the search. Only the
+ *	Src structures on the path to the file found are created.
+ *
+ * Input:
+ *	plan		plan for the suffixes of targs
+ *	targs		list of Src structures for the target
+ *	slst		list to which intermediate structures go
+ *
+ * Results:
+ *	The lowest structure in the chain of transformations
+ *
+ * Side Effects:
+ *	None
+ *-----------------------------------------------------------------------
+ */
+static Src *
+SuffFindPlanned(SuffPlan *plan, Lst targs, Lst slst)
+{
+    Src		**roots;
+    Src		*rs;
+    SuffStep	*st;
+    LstNode	ln;
+    char	*file, *ptr;
+    int		i, n, plen, maxPref, curRoot;
+
+    if (plan->nsteps == 0)
+	return NULL;
+
+    for (n = 0, ln = Lst_First(targs); ln != NULL; ln = Lst_Succ(ln))
+	n++;
+    roots = bmake_malloc(n * sizeof(Src *));
+    maxPref = 0;
+    for (i = 0, ln = Lst_First(targs); ln != NULL; ln = Lst_Succ(ln), i++) {
+	roots[i] = (Src *)Lst_Datum(ln);
+	plen = strlen(roots[i]->pref);
+	if (plen > maxPref)
+	    maxPref = plen;
+    }
+    SuffTrieBuild();
+    file = bmake_malloc(maxPref + suffTrieMax + 1);
+
+    rs = NULL;
+    curRoot = -1;
+    plen = 0;
+    for (i = 0; i < plan->nsteps; i++) {
+	st = &plan->steps[i];
+	if (st->root != curRoot) {
+	    curRoot = st->root;
+	    plen = strlen(roots[curRoot]->pref);
+	    memcpy(file, roots[curRoot]->pref, plen);
+	}
+	if (st->bare)
+	    file[plen] = '\0';
+	else
+	    memcpy(file + plen, st->suff->name, st->suff->nameLen + 1);
+
+	if (DEBUG(SUFF)) {
+	    fprintf(debug_file, "\ttrying %s...", file);
+	}
+
+	/*
+	 * A file is considered to exist if either a node exists in the
+	 * graph for it or the file actually exists.
+	 */
+	if (Targ_FindNode(file, TARG_NOCREATE) != NULL) {
+	    rs = SuffPlanSrc(plan, i, roots, slst);
+	    break;
+	}
+
+	if ((ptr = Dir_FindFile(file, st->suff->searchPath)) != NULL) {
+	    rs = SuffPlanSrc(plan, i, roots, slst);
+	    free(ptr);
+	    break;
+	}
+
+	if (DEBUG(SUFF)) {
+	    fprintf(debug_file, "not there\n");
+	}
+    }
+
+    if (DEBUG(SUFF) && rs) {
+	fprintf(debug_file, "got it\n");
+    }
+    free(file);
+    free(roots);
+    return (rs);
+}
+
 /*-
  *-----------------------------------------------------------------------
  * SuffFindCmds --
@@ -1452,8 +1936,7 @@ SuffFindCmds(Src *targ, Lst slst)
 	 * The node matches the prefix ok, see if it has a known
 	 * suffix.
 	 */
-	ln = Lst_Find(sufflist, &cp[prefLen], SuffSuffHasNameP);
-	if (ln == NULL)
+	if (SuffTrieMatch(&cp[prefLen], strlen(&cp[prefLen]), TRUE) == 0)
 	    continue;
 	/*
 	 * It even has a known suffix, see if there's a transformation
@@ -1461,7 +1944,7 @@ SuffFindCmds(Src *targ, Lst slst)
 	 *
 	 * XXX: Handle multi-stage transformations here, too.
 	 */
-	suff = (Suff *)Lst_Datum(ln);
+	suff = suffMatch[0];
 
 	if (Lst_Member(suff->parents, targ->suff) != NULL)
 	    break;
@@ -1739,17 +2222,13 @@ Suff_FindPath(GNode* gn)
     Suff *suff = gn->suffix;
 
     if (suff == NULL) {
-	SuffixCmpData sd;   /* Search string data */
-	LstNode ln;
-	sd.len = strlen(gn->name);
-	sd.ename = gn->name + sd.len;
-	ln = Lst_Find(sufflist, &sd, SuffSuffIsSuffixP);
+	int nmatch = SuffTrieMatch(gn->name, strlen(gn->name), FALSE);
 
 	if (DEBUG(SUFF)) {
 	    fprintf(debug_file, "Wildcard expanding \"%s\"...", gn->name);
 	}
-	if (ln != NULL)
-	    suff = (Suff *)Lst_Datum(ln);
+	if (nmatch > 0)
+	    suff = suffMatch[0];
 	/* XXX: Here we can save the suffix so we don't have to do this again */
     }
 
@@ -2025,18 +2504,18 @@ SuffFindNormalDeps(GNode *gn, Lst slst)
     Src 	*src;	    /* General Src pointer */
     char    	*pref;	    /* Prefix to use */
     Src	    	*targ;	    /* General Src target pointer */
-    SuffixCmpData sd;	    /* Search string data */
+    SuffPlan	*plan;	    /* Memoized search for these suffixes */
+    Boolean	search;	    /* Look for implied sources at all */
+    int		nameLen;    /* Length of the target name */
+    int		nmatch;	    /* Number of suffixes the target has */
+    int		i;
 
 
-    sd.len = strlen(gn->name);
-    sd.ename = eoname = gn->name + sd.len;
+    nameLen = strlen(gn->name);
+    eoname = gn->name + nameLen;
 
     sopref = gn->name;
 
-    /*
-     * Begin at the beginning...
-     */
-    ln = Lst_First(sufflist);
     srcs = Lst_Init(FALSE);
     targs = Lst_Init(FALSE);
 
@@ -2063,54 +2542,39 @@ SuffFindNormalDeps(GNode *gn, Lst slst)
 
     if (!(gn->type & OP_PHONY)) {
 
-	while (ln != NULL) {
+	search = TRUE;
+	nmatch = SuffTrieMatch(gn->name, nameLen, FALSE);
+	for (i = 0; i < nmatch; i++) {
+	    int	    prefLen;	    /* Length of the prefix */
+
 	    /*
-	     * Look for next possible suffix...
+	     * Allocate a Src structure to which things can be transformed
 	     */
-	    ln = Lst_FindFrom(sufflist, ln, &sd, SuffSuffIsSuffixP);
-
-	    if (ln != NULL) {
-		int	    prefLen;	    /* Length of the prefix */
-
-		/*
-		 * Allocate a Src structure to which things can be transformed
-		 */
-		targ = bmake_malloc(sizeof(Src));
-		targ->file = bmake_strdup(gn->name);
-		targ->suff = (Suff *)Lst_Datum(ln);
-		targ->suff->refCount++;
-		targ->node = gn;
-		targ->parent = NULL;
-		targ->children = 0;
+	    targ = bmake_malloc(sizeof(Src));
+	    targ->file = bmake_strdup(gn->name);
+	    targ->suff = suffMatch[i];
+	    targ->suff->refCount++;
+	    targ->node = gn;
+	    targ->parent = NULL;
+	    targ->children = 0;
 #ifdef DEBUG_SRC
-		targ->cp = Lst_Init(FALSE);
+	    targ->cp = Lst_Init(FALSE);
 #endif
 
-		/*
-		 * Allocate room for the prefix, whose end is found by
-		 * subtracting the length of the suffix from
-		 * the end of the name.
-		 */
-		prefLen = (eoname - targ->suff->nameLen) - sopref;
-		targ->pref = bmake_malloc(prefLen + 1);
-		memcpy(targ->pref, sopref, prefLen);
-		targ->pref[prefLen] = '\0';
-
-		/*
-		 * Add nodes from which the target can be made
-		 */
-		SuffAddLevel(srcs, targ);
-
-		/*
-		 * Record the target so we can nuke it
-		 */
-		(void)Lst_AtEnd(targs, targ);
+	    /*
+	     * Allocate room for the prefix, whose end is found by
+	     * subtracting the length of the suffix from
+	     * the end of the name.
+	     */
+	    prefLen = (eoname - targ->suff->nameLen) - sopref;
+	    targ->pref = bmake_malloc(prefLen + 1);
+	    memcpy(targ->pref, sopref, prefLen);
+	    targ->pref[prefLen] = '\0';
 
-		/*
-		 * Search from this suffix's successor...
-		 */
-		ln = Lst_Succ(ln);
-	    }
+	    /*
+	     * Record the target so we can nuke it
+	     */
+	    (void)Lst_AtEnd(targs, targ);
 	}
 
 	/*
@@ -2139,9 +2603,8 @@ SuffFindNormalDeps(GNode *gn, Lst slst)
 	     * not define suffix rules if the gnode had children but we
 	     * don't do this anymore.
 	     */
-	    if (Lst_IsEmpty(gn->commands))
-		SuffAddLevel(srcs, targ);
-	    else {
+	    if (!Lst_IsEmpty(gn->commands)) {
+		search = FALSE;
 		if (DEBUG(SUFF))
 		    fprintf(debug_file, "not ");
 	    }
@@ -2153,10 +2616,19 @@ SuffFindNormalDeps(GNode *gn, Lst slst)
 	}
 
 	/*
-	 * Using the list of possible sources built up from the target
-	 * suffix(es), try and find an existing file/target that matches.
+	 * Using the possible sources implied by the target suffix(es),
+	 * try and find an existing file/target that matches. The walk
+	 * depends only on the suffixes, so it is normally memoized.
 	 */
-	bottom = SuffFindThem(srcs, slst);
+	if (!search)
+	    bottom = NULL;
+	else if ((plan = SuffGetPlan(targs)) != NULL)
+	    bottom = SuffFindPlanned(plan, targs, slst);
+	else {
+	    for (ln = Lst_First(targs); ln != NULL; ln = Lst_Succ(ln))
+		SuffAddLevel(srcs, (Src *)Lst_Datum(ln));
+	    bottom = SuffFindThem(srcs, slst);
+	}
 
 	if (bottom == NULL) {
 	    /*
@@ -2503,6 +2975,7 @@ Suff_SetNull(char *name)
 	 * XXX: Here's where the transformation mangling would take place
 	 */
 	suffNull = s;
+	suffGen++;
     } else {
 	Parse_Error(PARSE_WARNING, "Desired null suffix %s not defined.",
 		     name);
@@ -2530,6 +3003,7 @@ Suff_Init(void)
 #endif
     srclist = Lst_Init(FALSE);
     transforms = Lst_Init(FALSE);
+    Hash_InitTable(&suffPlans, 0);
 
     sNum = 0;
     /*
@@ -2576,6 +3050,10 @@ Suff_End(void)
 	SuffFree(suffNull);
     Lst_Destroy(srclist, NULL);
     Lst_Destroy(transforms, NULL);
+    SuffPlanFlush();
+    Hash_DeleteTable(&suffPlans);
+    SuffTrieFree(suffTrie);
+    free(suffMatch);
 #endif
 }
 
@@ -250,6 +250,7 @@ Targ_NewGN(const char *name)
     gn->flags = 	0;
     gn->checked =	0;
     gn->mtime =		0;
+    gn->srcmtime =	0;
     gn->cmgn =		NULL;
     gn->iParents =  	Lst_Init(FALSE);
     gn->cohorts =   	Lst_Init(FALSE);
@@ -43,6 +43,18 @@ __RCSID("$NetBSD: trace.c,v 1.11 2008/12/28 18:31:51 christos Exp $");
  * trace.c --
  *	handle logging of trace events generated by various parts of make.
  *
+ *	If the trace file name ends in ".json" the events are written in
+ *	the Chrome trace-event format instead of one line of text each,
+ *	so a build can be loaded into chrome://tracing or Perfetto. Each
+ *	job becomes a span on one of a set of lanes (one per job slot in
+ *	use), and the make itself a span on lane 0. The file is shared by
+ *	recursive makes, which receive -T through MAKEFLAGS; each appears
+ *	as its own process, named and ordered by .MAKE.LEVEL. Events are
+ *	buffered and written a whole number of events at a time, so that
+ *	concurrent makes appending to the file do not tear each other's
+ *	records. The closing ']' is never written; both viewers accept
+ *	an unterminated array, which is what makes appending possible.
+ *
  * Interface:
  *	Trace_Init		Initialize tracing (called once during
  *				the lifetime of the process)
@@ -52,7 +64,9 @@ __RCSID("$NetBSD: trace.c,v 1.11 2008/12/28 18:31:51 christos Exp $");
  *	Trace_Log		Log an event about a particular make job.
  */
 
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 
 #include <stdio.h>
 #include <unistd.h>
@@ -61,10 +75,17 @@ __RCSID("$NetBSD: trace.c,v 1.11 2008/12/28 18:31:51 christos Exp $");
 #include "job.h"
 #include "trace.h"
 
+#define TRACE_BUFSIZE	65536
+
 static FILE *trfile;
 static pid_t trpid;
 char *trwd;
 
+static Boolean trjson;		/* writing trace-event JSON */
+static Buffer trbuf;		/* JSON events not yet written */
+static Job **trlane;		/* job occupying each lane, or NULL */
+static int trnlanes;
+
 static const char *evname[] = {
 	"BEG",
 	"END",
@@ -74,15 +95,212 @@ static const char *evname[] = {
 	"INT",
 };
 
+static void
+TraceFlush(void)
+{
+	Byte *data;
+	int len;
+
+	data = Buf_GetAll(&trbuf, &len);
+	if (len > 0)
+		(void)write(fileno(trfile), data, len);
+	Buf_Empty(&trbuf);
+}
+
+static void
+TraceAdd(const char *s)
+{
+	Buf_AddBytes(&trbuf, strlen(s), (const Byte *)s);
+}
+
+static void
+TraceAddString(const char *s)
+{
+	char hex[8];
+
+	Buf_AddByte(&trbuf, '"');
+	for (; *s != '\0'; s++) {
+		if (*s == '"' || *s == '\\') {
+			Buf_AddByte(&trbuf, '\\');
+			Buf_AddByte(&trbuf, *s);
+		} else if ((unsigned char)*s < 0x20) {
+			snprintf(hex, sizeof(hex), "\\u%04x", (unsigned char)*s);
+			TraceAdd(hex);
+		} else
+			Buf_AddByte(&trbuf, *s);
+	}
+	Buf_AddByte(&trbuf, '"');
+}
+
+/*
+ * Start an event record; the caller adds any "args" and closes it
+ * with TraceEventEnd.
+ */
+static void
+TraceEvent(const char *ph, const char *name, int tid,
+    const struct timeval *tv)
+{
+	char num[96];
+
+	TraceAdd("{\"ph\":");
+	TraceAddString(ph);
+	TraceAdd(",\"name\":");
+	TraceAddString(name);
+	if (tv != NULL)
+		snprintf(num, sizeof(num),
+		    ",\"pid\":%d,\"tid\":%d,\"ts\":%lld",
+		    trpid, tid, (long long)tv->tv_sec * 1000000 +
+		    tv->tv_usec);
+	else
+		snprintf(num, sizeof(num), ",\"pid\":%d,\"tid\":%d",
+		    trpid, tid);
+	TraceAdd(num);
+}
+
+static void
+TraceEventEnd(void)
+{
+	TraceAdd("},\n");
+}
+
+/*
+ * Return the lane for a job: the first free one when it starts, the
+ * one it was given when it ends. Lane 0 is make itself.
+ */
+static int
+TraceLane(Job *job, Boolean starting)
+{
+	int i, avail = -1;
+
+	for (i = 0; i < trnlanes; i++) {
+		if (trlane[i] == job) {
+			if (!starting)
+				trlane[i] = NULL;
+			return i + 1;
+		}
+		if (trlane[i] == NULL && avail < 0)
+			avail = i;
+	}
+	if (!starting)
+		return 0;
+	if (avail < 0) {
+		avail = trnlanes++;
+		trlane = bmake_realloc(trlane, trnlanes * sizeof(Job *));
+	}
+	trlane[avail] = job;
+	return avail + 1;
+}
+
+static void
+TraceJSONInit(void)
+{
+	struct stat st;
+	char name[MAXPATHLEN + 64];
+	char num[64];
+
+	trjson = TRUE;
+	Buf_Init(&trbuf, TRACE_BUFSIZE);
+
+	/* The first make to open the file starts the array */
+	if (fstat(fileno(trfile), &st) == 0 && st.st_size == 0) {
+		TraceAdd("[\n");
+		TraceFlush();
+	}
+
+	snprintf(name, sizeof(name), "%s %s", progname, trwd);
+	TraceEvent("M", "process_name", 0, NULL);
+	TraceAdd(",\"args\":{\"name\":");
+	TraceAddString(name);
+	TraceAdd("}");
+	TraceEventEnd();
+	TraceEvent("M", "process_sort_index", 0, NULL);
+	snprintf(num, sizeof(num), ",\"args\":{\"sort_index\":%d}",
+	    makelevel);
+	TraceAdd(num);
+	TraceEventEnd();
+	TraceEvent("M", "thread_name", 0, NULL);
+	TraceAdd(",\"args\":{\"name\":\"make\"}");
+	TraceEventEnd();
+}
+
+static void
+TraceJSONLog(TrEvent event, Job *job, const struct timeval *tv)
+{
+	char num[96];
+	int tid;
+
+	switch (event) {
+	case MAKESTART:
+		TraceEvent("B", "make", 0, tv);
+		snprintf(num, sizeof(num), ",\"args\":{\"level\":%d,\"cwd\":",
+		    makelevel);
+		TraceAdd(num);
+		TraceAddString(trwd);
+		TraceAdd("}");
+		TraceEventEnd();
+		break;
+	case JOBSTART:
+		tid = TraceLane(job, TRUE);
+		TraceEvent("B", job->node->name, tid, tv);
+		snprintf(num, sizeof(num),
+		    ",\"args\":{\"pid\":%d,\"flags\":\"%x\",\"type\":\"%x\"}",
+		    job->pid, job->flags, job->node->type);
+		TraceAdd(num);
+		TraceEventEnd();
+		break;
+	case JOBEND:
+		tid = TraceLane(job, FALSE);
+		TraceEvent("E", job->node->name, tid, tv);
+		if (WIFEXITED(job->exit_status))
+			snprintf(num, sizeof(num), ",\"args\":{\"status\":%d}",
+			    WEXITSTATUS(job->exit_status));
+		else
+			snprintf(num, sizeof(num), ",\"args\":{\"signal\":%d}",
+			    WTERMSIG(job->exit_status));
+		TraceAdd(num);
+		TraceEventEnd();
+		break;
+	case MAKEERROR:
+	case MAKEINTR:
+		TraceEvent("i", event == MAKEERROR ? "error" : "interrupt",
+		    0, tv);
+		TraceAdd(",\"s\":\"p\"");
+		TraceEventEnd();
+		/* FALLTHROUGH */
+	case MAKEEND:
+		TraceEvent("E", "make", 0, tv);
+		TraceEventEnd();
+		break;
+	}
+
+	TraceEvent("C", "jobTokensRunning", 0, tv);
+	snprintf(num, sizeof(num), ",\"args\":{\"running\":%d}",
+	    jobTokensRunning);
+	TraceAdd(num);
+	TraceEventEnd();
+
+	/* make is likely to exit without calling Trace_End after these */
+	if (event != JOBSTART && event != JOBEND)
+		TraceFlush();
+	else if (Buf_Size(&trbuf) >= TRACE_BUFSIZE)
+		TraceFlush();
+}
+
 void
 Trace_Init(const char *pathname)
 {
 	char *p1;
+	size_t len;
+
 	if (pathname != NULL) {
 		trpid = getpid();
 		trwd = Var_Value(".CURDIR", VAR_GLOBAL, &p1);
 
 		trfile = fopen(pathname, "a");
+		len = strlen(pathname);
+		if (trfile != NULL && len > 5 &&
+		    strcmp(pathname + len - 5, ".json") == 0)
+			TraceJSONInit();
 	}
 }
 
@@ -96,6 +314,11 @@ Trace_Log(TrEvent event, Job *job)
 
 	gettimeofday(&rightnow, NULL);
 
+	if (trjson) {
+		TraceJSONLog(event, job, &rightnow);
+		return;
+	}
+
 	fprintf(trfile, "%lld.%06ld %d %s %d %s",
 	    (long long)rightnow.tv_sec, (long)rightnow.tv_usec,
 	    jobTokensRunning,
@@ -111,6 +334,9 @@ Trace_Log(TrEvent event, Job *job)
 void
 Trace_End(void)
 {
-	if (trfile != NULL)
+	if (trfile != NULL) {
+		if (trjson)
+			TraceFlush();
 		fclose(trfile);
+	}
 }
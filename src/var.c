@@ -319,8 +319,7 @@ static char *VarModify(GNode *, Var_Parse_State *,
     Boolean (*)(GNode *, Var_Parse_State *, char *, Boolean, Buffer *, void *),
     void *);
 static char *VarOrder(const char *, const char);
-static char *VarUniq(const char *);
-static int VarWordCompare(const void *, const void *);
+static char *VarUniq(const char *, Boolean);
 static void VarPrintVar(void *);
 
 #define BROPEN	'{'
@@ -328,6 +327,98 @@ static void VarPrintVar(void *);
 #define PROPEN	'('
 #define PRCLOSE	')'
 
+/*
+ * Snapshot of the environment for VarFind: name -> strdup'd value,
+ * or NULL for a name known not to be set.  Kept in step with our own
+ * setenv/unsetenv calls by Var_EnvUpdate, and rebuilt if environ is
+ * replaced behind our back.
+ */
+extern char **environ;
+static Hash_Table envCache;
+static char **envCacheEnv = NULL;	/* environ the snapshot is of */
+
+static void
+VarEnvCacheBuild(void)
+{
+    Hash_Search search;
+    Hash_Entry *he;
+    char **ep, *cp, *name;
+    int new;
+
+    if (envCacheEnv != NULL) {
+	for (he = Hash_EnumFirst(&envCache, &search); he != NULL;
+	     he = Hash_EnumNext(&search))
+	    free(Hash_GetValue(he));
+	Hash_DeleteTable(&envCache);
+    }
+    Hash_InitTable(&envCache, 1024);
+    for (ep = environ; ep && *ep; ep++) {
+	if ((cp = strchr(*ep, '=')) == NULL)
+	    continue;
+	name = bmake_strndup(*ep, cp - *ep);
+	he = Hash_CreateEntry(&envCache, name, &new);
+	if (new)		/* first one wins, as with getenv */
+	    Hash_SetValue(he, bmake_strdup(cp + 1));
+	free(name);
+    }
+    envCacheEnv = environ;
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * Var_EnvUpdate --
+ *	Tell the environment snapshot that name was set or unset,
+ *	or with a NULL name that environ was replaced wholesale.
+ *
+ * Results:
+ *	None
+ *
+ * Side Effects:
+ *	The cached value of name is refreshed from getenv.
+ *-----------------------------------------------------------------------
+ */
+void
+Var_EnvUpdate(const char *name)
+{
+    Hash_Entry *he;
+    const char *val;
+
+    if (envCacheEnv == NULL)
+	return;			/* nothing cached yet */
+    if (name == NULL) {
+	VarEnvCacheBuild();
+	return;
+    }
+    if (envCacheEnv != environ) {
+	/*
+	 * setenv may have moved environ; anything else still matches
+	 * the snapshot, as long as all changes come through here.
+	 */
+	envCacheEnv = environ;
+    }
+    he = Hash_CreateEntry(&envCache, name, NULL);
+    free(Hash_GetValue(he));
+    val = getenv(name);
+    Hash_SetValue(he, val ? bmake_strdup(val) : NULL);
+}
+
+/*
+ * getenv through the snapshot, caching misses too
+ */
+static const char *
+VarGetEnv(const char *name)
+{
+    Hash_Entry *he;
+    int new;
+
+    if (envCacheEnv != environ)
+	VarEnvCacheBuild();
+    he = Hash_CreateEntry(&envCache, name, &new);
+    if (new)
+	Hash_SetValue(he, NULL);
+    return Hash_GetValue(he);
+}
+
 /*-
  *-----------------------------------------------------------------------
  * VarFind --
@@ -397,6 +488,11 @@ VarFind(const char *name, GNode *ctxt, int flags)
 	    name = ALLSRC;
 #endif
 
+    /* .ALLSRC and .OODATE are built when first wanted */
+    if ((ctxt->flags & LAZY_ALLSRC) && name[1] == '\0' &&
+	(name[0] == *ALLSRC || name[0] == *OODATE))
+	Make_ExpandAllSrc(ctxt);
+
     /*
      * First look for the variable in the given context. If it's not there,
      * look for it in VAR_CMD, VAR_GLOBAL and the environment, in that order,
@@ -417,9 +513,9 @@ VarFind(const char *name, GNode *ctxt, int flags)
 	}
     }
     if ((var == NULL) && (flags & FIND_ENV)) {
-	char *env;
+	const char *env;
 
-	if ((env = getenv(name)) != NULL) {
+	if ((env = VarGetEnv(name)) != NULL) {
 	    int		len;
 
 	    v = bmake_malloc(sizeof(Var));
@@ -561,6 +657,7 @@ Var_Delete(const char *name, GNode *ctxt)
 	v = (Var *)Hash_GetValue(ln);
 	if ((v->flags & VAR_EXPORTED)) {
 	    unsetenv(v->name);
+	    Var_EnvUpdate(v->name);
 	}
 	if (strcmp(MAKE_EXPORTED, v->name) == 0) {
 	    var_exportedVars = VAR_EXPORTED_NONE;
@@ -653,6 +750,7 @@ Var_Export1(const char *name, int parent)
 	if (n < (int)sizeof(tmp)) {
 	    val = Var_Subst(NULL, tmp, VAR_GLOBAL, 0);
 	    setenv(name, val, 1);
+	    Var_EnvUpdate(name);
 	    free(val);
 	}
     } else {
@@ -661,6 +759,7 @@ Var_Export1(const char *name, int parent)
 	}
 	if (parent || !(v->flags & VAR_EXPORTED)) {
 	    setenv(name, val, 1);
+	    Var_EnvUpdate(name);
 	}
     }
     /*
@@ -693,6 +792,7 @@ Var_ExportVars(void)
      */
     snprintf(tmp, sizeof(tmp), "%d", makelevel + 1);
     setenv(MAKE_LEVEL_ENV, tmp, 1);
+    Var_EnvUpdate(MAKE_LEVEL_ENV);
 
     if (VAR_EXPORTED_NONE == var_exportedVars)
 	return;
@@ -833,6 +933,7 @@ Var_UnExport(char *str)
 	newenv[0] = NULL;
 	newenv[1] = NULL;
 	setenv(MAKE_LEVEL_ENV, cp, 1);
+	Var_EnvUpdate(NULL);
     } else {
 	for (; *str != '\n' && isspace((unsigned char) *str); str++)
 	    continue;
@@ -863,6 +964,7 @@ Var_UnExport(char *str)
 	    if (!unexport_env &&
 		(v->flags & (VAR_EXPORTED|VAR_REEXPORT)) == VAR_EXPORTED) {
 		unsetenv(v->name);
+		Var_EnvUpdate(v->name);
 	    }
 	    v->flags &= ~(VAR_EXPORTED|VAR_REEXPORT);
 	    /*
@@ -924,6 +1026,8 @@ Var_Set(const char *name, const char *val, GNode *ctxt, int flags)
     Var   *v;
     char *expanded_name = NULL;
 
+    PROF_COUNT(PROF_VAR_SET);
+
     /*
      * We only look for a variable in the given context since anything set
      * here will override anything in a lower context, so there's not much
@@ -993,8 +1097,10 @@ Var_Set(const char *name, const char *val, GNode *ctxt, int flags)
 	 * that the command-line settings continue to override
 	 * Makefile settings.
 	 */
-	if (varNoExportEnv != TRUE)
+	if (varNoExportEnv != TRUE) {
 	    setenv(name, val, 1);
+	    Var_EnvUpdate(name);
+	}
 
 	Var_Append(MAKEOVERRIDES, name, VAR_GLOBAL);
     }
@@ -1355,9 +1461,11 @@ VarMatch(GNode *ctx MAKE_ATTR_UNUSED, Var_Parse_State *vpstate,
 	 char *word, Boolean addSpace, Buffer *buf,
 	 void *pattern)
 {
+    const StrPattern *pat = pattern;
+
     if (DEBUG(VAR))
-	fprintf(debug_file, "VarMatch [%s] [%s]\n", word, (char *)pattern);
-    if (Str_Match(word, (char *)pattern)) {
+	fprintf(debug_file, "VarMatch [%s] [%s]\n", word, pat->pattern);
+    if (Str_PatternMatch(pat, word)) {
 	if (addSpace && vpstate->varSpace) {
 	    Buf_AddByte(buf, vpstate->varSpace);
 	}
@@ -1446,7 +1554,7 @@ VarNoMatch(GNode *ctx MAKE_ATTR_UNUSED, Var_Parse_State *vpstate,
 	   char *word, Boolean addSpace, Buffer *buf,
 	   void *pattern)
 {
-    if (!Str_Match(word, (char *)pattern)) {
+    if (!Str_PatternMatch((const StrPattern *)pattern, word)) {
 	if (addSpace && vpstate->varSpace) {
 	    Buf_AddByte(buf, vpstate->varSpace);
 	}
@@ -1872,7 +1980,8 @@ VarSelectWords(GNode *ctx MAKE_ATTR_UNUSED, Var_Parse_State *vpstate,
     int ac, i;
     int start, end, step;
 
-    Buf_Init(&buf, 0);
+    /* the result is rarely much longer than str */
+    Buf_Init(&buf, strlen(str) + 1);
     addSpace = FALSE;
 
     if (vpstate->oneBigWord) {
@@ -1989,7 +2098,8 @@ VarModify(GNode *ctx, Var_Parse_State *vpstate,
     char *as;			    /* word list memory */
     int ac, i;
 
-    Buf_Init(&buf, 0);
+    /* the result is rarely much longer than str */
+    Buf_Init(&buf, strlen(str) + 1);
     addSpace = FALSE;
 
     if (vpstate->oneBigWord) {
@@ -2014,11 +2124,79 @@ VarModify(GNode *ctx, Var_Parse_State *vpstate,
 }
 
 
-static int
-VarWordCompare(const void *a, const void *b)
+#define VarWordChar(av, i, depth)	((unsigned char)(av)[i][depth])
+
+static void
+VarWordSwap(char **av, int i, int j, int n)
 {
-	int r = strcmp(*(const char * const *)a, *(const char * const *)b);
-	return r;
+    char *t;
+
+    for (; n > 0; i++, j++, n--) {
+	t = av[i];
+	av[i] = av[j];
+	av[j] = t;
+    }
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * VarSortWords --
+ *	Sort words as strcmp would, all of which agree on their first
+ *	depth characters. This is Bentley and Sedgewick's multikey
+ *	quicksort: it partitions on one character at a time, so the
+ *	long common prefixes of path names are compared only once
+ *	rather than by every strcmp of a qsort.
+ *
+ * Results:
+ *	None.
+ *
+ * Side Effects:
+ *	The words in av are reordered.
+ *-----------------------------------------------------------------------
+ */
+static void
+VarSortWords(char **av, int n, int depth)
+{
+    int a, b, c, d, r, pivot;
+
+    if (n < 10) {
+	for (a = 1; a < n; a++)
+	    for (b = a; b > 0 &&
+		     strcmp(av[b - 1] + depth, av[b] + depth) > 0; b--)
+		VarWordSwap(av, b - 1, b, 1);
+	return;
+    }
+
+    VarWordSwap(av, 0, n / 2, 1);
+    pivot = VarWordChar(av, 0, depth);
+    a = b = 1;
+    c = d = n - 1;
+    for (;;) {
+	while (b <= c && (r = VarWordChar(av, b, depth) - pivot) <= 0) {
+	    if (r == 0)
+		VarWordSwap(av, a++, b, 1);
+	    b++;
+	}
+	while (b <= c && (r = VarWordChar(av, c, depth) - pivot) >= 0) {
+	    if (r == 0)
+		VarWordSwap(av, c, d--, 1);
+	    c--;
+	}
+	if (b > c)
+	    break;
+	VarWordSwap(av, b++, c--, 1);
+    }
+    /* move the words equal to the pivot to the middle */
+    r = MIN(a, b - a);
+    VarWordSwap(av, 0, b - r, r);
+    r = MIN(d - c, n - d - 1);
+    VarWordSwap(av, b, n - r, r);
+
+    VarSortWords(av, b - a, depth);
+    if (pivot != 0)
+	VarSortWords(av + b - a, a + n - d - 1, depth + 1);
+    r = d - c;
+    VarSortWords(av + n - r, r, depth);
 }
 
 /*-
@@ -2046,14 +2224,14 @@ VarOrder(const char *str, const char otype)
     char *as;			    /* word list memory */
     int ac, i;
 
-    Buf_Init(&buf, 0);
+    Buf_Init(&buf, strlen(str) + 1);
 
     av = brk_string(str, &ac, FALSE, &as);
 
     if (ac > 0)
 	switch (otype) {
 	case 's':	/* sort alphabetically */
-	    qsort(av, ac, sizeof(char *), VarWordCompare);
+	    VarSortWords(av, ac, 0);
 	    break;
 	case 'x':	/* randomize */
 	{
@@ -2093,10 +2271,12 @@ VarOrder(const char *str, const char otype)
 /*-
  *-----------------------------------------------------------------------
  * VarUniq --
- *	Remove adjacent duplicate words.
+ *	Remove adjacent duplicate words, or with all set, every word
+ *	that has already been seen, keeping the original order.
  *
  * Input:
  *	str		String whose words should be sorted
+ *	all		Whether duplicates need not be adjacent
  *
  * Results:
  *	A string containing the resulting words.
@@ -2107,17 +2287,28 @@ VarOrder(const char *str, const char otype)
  *-----------------------------------------------------------------------
  */
 static char *
-VarUniq(const char *str)
+VarUniq(const char *str, Boolean all)
 {
     Buffer	  buf;		    /* Buffer for new string */
     char 	**av;		    /* List of words to affect */
     char 	 *as;		    /* Word list memory */
     int 	  ac, i, j;
+    Hash_Table	  seen;		    /* Words kept so far, for all */
+    int		  new;
 
-    Buf_Init(&buf, 0);
+    Buf_Init(&buf, strlen(str) + 1);
     av = brk_string(str, &ac, FALSE, &as);
 
-    if (ac > 1) {
+    if (all && ac > 1) {
+	Hash_InitTable(&seen, ac);
+	for (j = i = 0; i < ac; i++) {
+	    (void)Hash_CreateEntry(&seen, av[i], &new);
+	    if (new)
+		av[j++] = av[i];
+	}
+	Hash_DeleteTable(&seen);
+	ac = j;
+    } else if (ac > 1) {
 	for (j = 0, i = 1; i < ac; i++)
 	    if (strcmp(av[i], av[j]) != 0 && (++j != i))
 		av[j] = av[i];
@@ -3095,6 +3286,7 @@ ApplyModifiers(char *nstr, const char *tstr,
 	case 'M':
 	    {
 		char    *pattern;
+		StrPattern spat;
 		const char *endpat; /* points just after end of pattern */
 		char    *cp2;
 		Boolean copy;	/* pattern should be, or has been, copied */
@@ -3176,12 +3368,14 @@ ApplyModifiers(char *nstr, const char *tstr,
 		if (DEBUG(VAR))
 		    fprintf(debug_file, "Pattern[%s] for [%s] is [%s]\n",
 			v->name, nstr, pattern);
+		/* prepared once for all the words */
+		Str_PatternInit(&spat, pattern);
 		if (*tstr == 'M') {
 		    newStr = VarModify(ctxt, &parsestate, nstr, VarMatch,
-				       pattern);
+				       &spat);
 		} else {
 		    newStr = VarModify(ctxt, &parsestate, nstr, VarNoMatch,
-				       pattern);
+				       &spat);
 		}
 		free(pattern);
 		break;
@@ -3432,11 +3626,17 @@ ApplyModifiers(char *nstr, const char *tstr,
 	    }
 	case 'u':
 	    if (tstr[1] == endc || tstr[1] == ':') {
-		newStr = VarUniq(nstr);
+		newStr = VarUniq(nstr, FALSE);
 		cp = tstr + 1;
 		termc = *cp;
 		break;
 	    }
+	    if (tstr[1] == 'a' && (tstr[2] == endc || tstr[2] == ':')) {
+		newStr = VarUniq(nstr, TRUE);
+		cp = tstr + 2;
+		termc = *cp;
+		break;
+	    }
 	    goto default_case;
 #ifdef SUNSHCMD
 	case 's':
@@ -3955,6 +4155,7 @@ Var_Subst(const char *var, const char *str, GNode *ctxt, Boolean undefErr)
 				     * been reported to prevent a plethora
 				     * of messages when recursing */
 
+    PROF_COUNT(PROF_VAR_SUBST);
     Buf_Init(&buf, 0);
     errorReported = FALSE;
     trailingBslash = FALSE;